@@ -0,0 +1,199 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/affinity.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace micro_tcp
+{
+    namespace
+    {
+        const std::string cpu_sysfs_path = "/sys/devices/system/cpu/";
+
+        std::string read_line(const std::string& path)
+        {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+    }
+
+    affinity_plan::affinity_plan() :
+            placement_(placement::none)
+    {
+        /*...*/
+    }
+
+    /*static*/affinity_plan affinity_plan::cpu_list(std::vector<unsigned int> cpus)
+    {
+        affinity_plan plan;
+        plan.placement_ = placement::cpu_list;
+        plan.cpus_ = std::move(cpus);
+        return plan;
+    }
+
+    /*static*/affinity_plan affinity_plan::physical_cores()
+    {
+        affinity_plan plan;
+        plan.placement_ = placement::physical_cores;
+        return plan;
+    }
+
+    /*static*/bool affinity_plan::parse(const std::string& plan, affinity_plan& result)
+    {
+        if (plan.empty() || plan == "none")
+        {
+            result = affinity_plan();
+            return true;
+        }
+        if (plan == "physical_cores")
+        {
+            result = physical_cores();
+            return true;
+        }
+        std::vector<unsigned int> cpus;
+        if (parse_cpu_list(plan, cpus) && !cpus.empty())
+        {
+            result = cpu_list(std::move(cpus));
+            return true;
+        }
+        std::cerr << __PRETTY_FUNCTION__ << " | " << "The affinity plan (" << plan << ") could not be parsed\n";
+        return false;
+    }
+
+    affinity_plan::placement affinity_plan::get_placement() const
+    {
+        return placement_;
+    }
+
+    std::vector<unsigned int> affinity_plan::resolve() const
+    {
+        if (placement_ != placement::physical_cores)
+        {
+            return cpus_;
+        }
+
+        // A logical CPU is the first of its physical core if it is the lowest entry of its thread siblings.
+        std::vector<unsigned int> online;
+        if (!parse_cpu_list(read_line(cpu_sysfs_path + "online"), online) || online.empty())
+        {
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The CPU topology could not be read, threads are not pinned\n";
+            return {};
+        }
+        std::vector<unsigned int> cpus;
+        for (const auto cpu : online)
+        {
+            std::vector<unsigned int> siblings;
+            const auto path = cpu_sysfs_path + "cpu" + std::to_string(cpu) + "/topology/thread_siblings_list";
+            if (!parse_cpu_list(read_line(path), siblings) || siblings.empty() ||
+                *std::min_element(siblings.begin(), siblings.end()) == cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    /*static*/bool affinity_plan::pin_current_thread(unsigned int cpu)
+    {
+#ifdef __linux__
+        if (cpu >= CPU_SETSIZE)
+        {
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "CPU " << cpu << " is out of range\n";
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const auto result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (result != 0)
+        {
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The thread could not be pinned to CPU " << cpu << ": "
+                      << std::strerror(result) << '\n';
+            return false;
+        }
+        return true;
+#else
+        std::cerr << __PRETTY_FUNCTION__ << " | " << "Pinning threads is not supported on this system\n";
+        static_cast<void>(cpu);
+        return false;
+#endif
+    }
+
+    /*static*/unsigned int affinity_plan::numa_node(unsigned int cpu)
+    {
+        // The CPU directory contains a "node<N>" link to its NUMA node.
+        boost::system::error_code ec;
+        boost::filesystem::directory_iterator entry(cpu_sysfs_path + "cpu" + std::to_string(cpu), ec);
+        for (; !ec && entry != boost::filesystem::directory_iterator(); entry.increment(ec))
+        {
+            const auto name = entry->path().filename().string();
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                std::all_of(name.begin() + 4, name.end(), [](char c)
+                { return c >= '0' && c <= '9'; }))
+            {
+                return static_cast<unsigned int>(std::stoul(name.substr(4)));
+            }
+        }
+        return 0;
+    }
+
+    /*static*/bool affinity_plan::parse_cpu_list(const std::string& list, std::vector<unsigned int>& cpus)
+    {
+        std::istringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            unsigned int first = 0;
+            unsigned int last = 0;
+            char separator = 0;
+            std::istringstream range_stream(range);
+            if (!(range_stream >> first))
+            {
+                return false;
+            }
+            last = first;
+            if (range_stream >> separator && (separator != '-' || !(range_stream >> last) || last < first))
+            {
+                return false;
+            }
+            for (auto cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,126 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_AFFINITY_HPP
+#define MICRO_TCP_AFFINITY_HPP
+
+#include <string>
+#include <vector>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Describes on which CPUs the io threads of an io_manager are pinned. Worker [n] is pinned to CPU
+     * [n % cpus.size()] of the resolved plan and allocates its buffers from the pool of the NUMA node of that CPU.
+     *
+     * @see io_manager::set_affinity_plan(const micro_tcp::affinity_plan&)
+     */
+    class affinity_plan
+    {
+    public:
+        /**
+         * @brief How the CPUs of the plan are chosen.
+         */
+        enum class placement
+        {
+            none, /*!< Threads are not pinned. */
+            cpu_list, /*!< Threads are pinned to an explicit list of CPUs. */
+            physical_cores /*!< Threads are pinned to one logical CPU per physical core, skipping SMT siblings. */
+        };
+
+        /**
+         * @brief Default constructor. A plan that does not pin threads.
+         */
+        affinity_plan();
+
+        /**
+         * @brief
+         *
+         * @param cpus The CPUs to pin threads to, in order.
+         * @return A plan that pins threads to the given CPUs.
+         */
+        static affinity_plan cpu_list(std::vector<unsigned int> cpus);
+
+        /**
+         * @brief
+         *
+         * @return A plan that pins threads to the first logical CPU of every physical core.
+         */
+        static affinity_plan physical_cores();
+
+        /**
+         * @brief Create a plan from its textual form: "none", "physical_cores" or a CPU list such as "0,2,4-7".
+         *
+         * @param plan The textual form.
+         * @param result The plan, only set if parsing succeeded.
+         * @return True if the plan could be parsed.
+         */
+        static bool parse(const std::string& plan, affinity_plan& result);
+
+        /**
+         * @brief
+         *
+         * @return How the CPUs of the plan are chosen.
+         */
+        placement get_placement() const;
+
+        /**
+         * @brief Resolve the plan against the topology of this system.
+         *
+         * @return The CPUs to pin threads to, empty if threads are not pinned.
+         */
+        std::vector<unsigned int> resolve() const;
+
+        /**
+         * @brief Pin the calling thread to a CPU.
+         *
+         * @param cpu The CPU.
+         * @return False if pinning failed or is not supported on this system.
+         */
+        static bool pin_current_thread(unsigned int cpu);
+
+        /**
+         * @brief
+         *
+         * @param cpu The CPU.
+         * @return The NUMA node of the CPU, 0 if unknown.
+         */
+        static unsigned int numa_node(unsigned int cpu);
+
+    private:
+        /**
+         * @brief Parse a CPU list in the format of the Linux sysfs, e.g. "0-3,8,10-11".
+         *
+         * @param list The CPU list.
+         * @param cpus The parsed CPUs are appended.
+         * @return False if the list is malformed.
+         */
+        static bool parse_cpu_list(const std::string& list, std::vector<unsigned int>& cpus);
+
+        placement placement_;
+        std::vector<unsigned int> cpus_;
+    };
+}
+
+#endif
@@ -0,0 +1,327 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/buffer_pool.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace micro_tcp
+{
+    namespace
+    {
+        /**
+         * @brief Guards a size class of the global pool. Unlike std::mutex it cannot throw, so blocks can be handed to
+         * the global pool from buffer_pool::deallocate(). Held only for a few vector operations.
+         */
+        struct spin_lock
+        {
+            void lock() noexcept
+            {
+                while (locked_.test_and_set(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            void unlock() noexcept
+            {
+                locked_.clear(std::memory_order_release);
+            }
+
+            std::atomic_flag locked_ = ATOMIC_FLAG_INIT;
+        };
+
+        /**
+         * @brief Every pooled block is preceded by a header holding the NUMA node it was allocated on.
+         */
+        constexpr std::size_t block_header_size = alignof(std::max_align_t);
+
+        /**
+         * @brief NUMA node of the calling thread. Trivially destructible, so it outlives the thread cache.
+         */
+        thread_local std::size_t local_numa_node = 0;
+
+        void *new_block(std::size_t size_class)
+        {
+            const auto block_size = buffer_pool::min_block_size_ << size_class;
+            auto *header = static_cast<char *>(::operator new(block_header_size + block_size));
+            *reinterpret_cast<std::size_t *>(header) = local_numa_node;
+            return header + block_header_size;
+        }
+
+        void delete_block(void *block) noexcept
+        {
+            ::operator delete(static_cast<char *>(block) - block_header_size);
+        }
+
+        std::size_t owner_node(void *block) noexcept
+        {
+            return *reinterpret_cast<const std::size_t *>(static_cast<const char *>(block) - block_header_size);
+        }
+
+        /**
+         * @brief The global pool is sharded per NUMA node. Blocks are always returned to the shard of the node they
+         * were allocated on, whichever thread frees them, so a pinned thread only reuses blocks that were first
+         * touched on its own node.
+         */
+        struct global_pool
+        {
+            struct size_class_pool
+            {
+                spin_lock lock_;
+                std::vector<void *> blocks_;
+
+                /**
+                 * @brief Keep [block] if there is room, free it otherwise. Never allocates once the free list has been
+                 * reserved. The caller holds lock_.
+                 */
+                void release(void *block) noexcept
+                {
+                    if (blocks_.capacity() == 0)
+                    {
+                        try
+                        {
+                            blocks_.reserve(buffer_pool::global_cache_capacity_);
+                        }
+                        catch (const std::bad_alloc&)
+                        {
+                            /* Free the block below, the reservation is retried by the next release. */
+                        }
+                    }
+                    if (blocks_.size() < buffer_pool::global_cache_capacity_ && blocks_.size() < blocks_.capacity())
+                    {
+                        blocks_.push_back(block);
+                    }
+                    else
+                    {
+                        delete_block(block);
+                    }
+                }
+            };
+
+            std::array<std::array<size_class_pool, buffer_pool::size_class_count_>, buffer_pool::max_numa_nodes_> nodes_;
+            std::atomic<std::uint64_t> local_hits_{0};
+            std::atomic<std::uint64_t> global_hits_{0};
+            std::atomic<std::uint64_t> misses_{0};
+            std::atomic<std::uint64_t> oversized_{0};
+        };
+
+        /**
+         * @brief The global pool is never destroyed, blocks may be returned by objects with static storage duration
+         * that outlive any static pool instance.
+         */
+        global_pool& global()
+        {
+            static auto *pool = new global_pool();
+            return *pool;
+        }
+
+        /**
+         * @brief Set once the thread cache of the calling thread has been destroyed. Trivially destructible, so it can
+         * still be read by destructors of other thread_local and static objects that run after the cache is gone.
+         */
+        thread_local bool local_cache_destroyed = false;
+
+        struct local_cache
+        {
+            local_cache() :
+                    counts_(),
+                    local_hits_(0)
+            {
+                /*...*/
+            }
+
+            ~local_cache()
+            {
+                auto& pool = global();
+                for (std::size_t size_class = 0; size_class < buffer_pool::size_class_count_; ++size_class)
+                {
+                    release(size_class, counts_[size_class]);
+                }
+                pool.local_hits_.fetch_add(local_hits_, std::memory_order_relaxed);
+                local_cache_destroyed = true;
+            }
+
+            /**
+             * @brief Move up to [count] blocks of the size class from the global pool into this cache.
+             */
+            void acquire(std::size_t size_class, std::size_t count)
+            {
+                auto& pool = global().nodes_[local_numa_node][size_class];
+                std::lock_guard<spin_lock> lock(pool.lock_);
+                while (count-- > 0 && !pool.blocks_.empty())
+                {
+                    blocks_[size_class][counts_[size_class]++] = pool.blocks_.back();
+                    pool.blocks_.pop_back();
+                }
+            }
+
+            /**
+             * @brief Move [count] blocks of the size class from this cache to the global pool of this node, blocks that do not
+             * fit the global pool are freed. Never allocates once the free list has been reserved, so it is safe to
+             * call from buffer_pool::deallocate().
+             */
+            void release(std::size_t size_class, std::size_t count) noexcept
+            {
+                auto& pool = global().nodes_[local_numa_node][size_class];
+                std::lock_guard<spin_lock> lock(pool.lock_);
+                while (count-- > 0)
+                {
+                    pool.release(blocks_[size_class][--counts_[size_class]]);
+                }
+            }
+
+            void count_local_hit()
+            {
+                if (++local_hits_ == buffer_pool::statistics_batch_size_)
+                {
+                    global().local_hits_.fetch_add(local_hits_, std::memory_order_relaxed);
+                    local_hits_ = 0;
+                }
+            }
+
+            std::array<std::array<void *, buffer_pool::local_cache_capacity_>, buffer_pool::size_class_count_> blocks_;
+            std::array<std::size_t, buffer_pool::size_class_count_> counts_;
+            std::uint64_t local_hits_;
+        };
+
+        local_cache& local()
+        {
+            thread_local local_cache cache;
+            return cache;
+        }
+    }
+
+    /*static*/constexpr std::size_t buffer_pool::min_block_size_;
+    /*static*/constexpr std::size_t buffer_pool::size_class_count_;
+    /*static*/constexpr std::size_t buffer_pool::max_block_size_;
+    /*static*/constexpr std::size_t buffer_pool::local_cache_capacity_;
+    /*static*/constexpr std::size_t buffer_pool::global_cache_capacity_;
+    /*static*/constexpr std::uint64_t buffer_pool::statistics_batch_size_;
+    /*static*/constexpr std::size_t buffer_pool::max_numa_nodes_;
+
+    /*static*/void *buffer_pool::allocate(std::size_t size)
+    {
+        if (size > max_block_size_)
+        {
+            global().oversized_.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+
+        const auto index = size_class(size);
+        if (local_cache_destroyed)
+        {
+            global().misses_.fetch_add(1, std::memory_order_relaxed);
+            return new_block(index);
+        }
+        auto& cache = local();
+        if (cache.counts_[index] != 0)
+        {
+            cache.count_local_hit();
+            return cache.blocks_[index][--cache.counts_[index]];
+        }
+        cache.acquire(index, local_cache_capacity_ / 2);
+        if (cache.counts_[index] != 0)
+        {
+            global().global_hits_.fetch_add(1, std::memory_order_relaxed);
+            return cache.blocks_[index][--cache.counts_[index]];
+        }
+        global().misses_.fetch_add(1, std::memory_order_relaxed);
+        return new_block(index);
+    }
+
+    /*static*/void buffer_pool::deallocate(void *block, std::size_t size) noexcept
+    {
+        if (block == nullptr)
+        {
+            return;
+        }
+        if (size > max_block_size_)
+        {
+            ::operator delete(block);
+            return;
+        }
+
+        const auto index = size_class(size);
+        const auto numa_node = owner_node(block);
+        // Blocks of another node go straight back to the global pool of that node. So do blocks freed at thread or
+        // program exit, e.g. by another thread_local or a static object.
+        if (numa_node != local_numa_node || local_cache_destroyed)
+        {
+            auto& pool = global().nodes_[numa_node][index];
+            std::lock_guard<spin_lock> lock(pool.lock_);
+            pool.release(block);
+            return;
+        }
+        auto& cache = local();
+        if (cache.counts_[index] == local_cache_capacity_)
+        {
+            cache.release(index, local_cache_capacity_ / 2);
+        }
+        cache.blocks_[index][cache.counts_[index]++] = block;
+    }
+
+    /*static*/void buffer_pool::set_numa_node(unsigned int numa_node)
+    {
+        const std::size_t node = numa_node % max_numa_nodes_;
+        if (node == local_numa_node)
+        {
+            return;
+        }
+        if (!local_cache_destroyed)
+        {
+            // The cached blocks belong to the previous node, hand them back to it.
+            auto& cache = local();
+            for (std::size_t size_class = 0; size_class < size_class_count_; ++size_class)
+            {
+                cache.release(size_class, cache.counts_[size_class]);
+            }
+        }
+        local_numa_node = node;
+    }
+
+    /*static*/buffer_pool::statistics buffer_pool::get_statistics()
+    {
+        const auto& pool = global();
+        return {pool.local_hits_.load(std::memory_order_relaxed) + (local_cache_destroyed ? 0 : local().local_hits_),
+                pool.global_hits_.load(std::memory_order_relaxed),
+                pool.misses_.load(std::memory_order_relaxed),
+                pool.oversized_.load(std::memory_order_relaxed)};
+    }
+
+    /*static*/std::size_t buffer_pool::size_class(std::size_t size)
+    {
+        std::size_t index = 0;
+        for (auto block_size = min_block_size_; block_size < size; block_size <<= 1)
+        {
+            ++index;
+        }
+        return index;
+    }
+}
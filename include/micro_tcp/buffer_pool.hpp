@@ -0,0 +1,168 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_BUFFER_POOL_HPP
+#define MICRO_TCP_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Process wide pool of memory blocks in power-of-two size classes, used for message buffers.
+     *
+     * Blocks are served from a small cache per thread first, then from a global pool per size class (guarded by a
+     * spin lock, sharded per NUMA node) and only then from the heap. Freed blocks go back to the cache of the freeing
+     * thread if it runs on the node the block was allocated on and to the global pool of that node otherwise, cache
+     * overflow is handed to the global pool in batches. Requests larger than the biggest size class bypass the pool.
+     */
+    class buffer_pool
+    {
+    public:
+        /**
+         * @brief Counters of the pool. Hits served from a thread cache are published in batches, so
+         * statistics::local_hits_ may lag behind by up to buffer_pool::statistics_batch_size_ per thread.
+         */
+        struct statistics
+        {
+            std::uint64_t local_hits_; /*!< Allocations served from the cache of the calling thread. */
+            std::uint64_t global_hits_; /*!< Allocations served from the global pool. */
+            std::uint64_t misses_; /*!< Allocations of a size class that had to go to the heap. */
+            std::uint64_t oversized_; /*!< Allocations larger than buffer_pool::max_block_size_. */
+        };
+
+        /**
+         * @brief Block size of the smallest size class.
+         */
+        static constexpr std::size_t min_block_size_ = 64;
+        /**
+         * @brief Amount of size classes, doubling from buffer_pool::min_block_size_.
+         */
+        static constexpr std::size_t size_class_count_ = 15;
+        /**
+         * @brief Block size of the largest size class (1 MiB).
+         */
+        static constexpr std::size_t max_block_size_ = min_block_size_ << (size_class_count_ - 1);
+        /**
+         * @brief Maximum amount of cached blocks per size class per thread.
+         */
+        static constexpr std::size_t local_cache_capacity_ = 32;
+        /**
+         * @brief Maximum amount of blocks per size class kept in the global pool.
+         */
+        static constexpr std::size_t global_cache_capacity_ = 4096;
+        /**
+         * @brief Amount of thread cache hits counted locally before they are published.
+         */
+        static constexpr std::uint64_t statistics_batch_size_ = 1024;
+        /**
+         * @brief Amount of NUMA node shards of the global pool. Higher nodes share a shard (modulo).
+         */
+        static constexpr std::size_t max_numa_nodes_ = 8;
+
+        buffer_pool() = delete;
+
+        /**
+         * @brief Allocate a block of at least [size] bytes.
+         *
+         * @param size The requested size in bytes.
+         * @return Pointer to the block. Throws std::bad_alloc if the heap is exhausted.
+         */
+        static void *allocate(std::size_t size);
+
+        /**
+         * @brief Return a block obtained from buffer_pool::allocate(std::size_t) to the pool.
+         *
+         * @param block Pointer to the block.
+         * @param size The size passed to buffer_pool::allocate(std::size_t).
+         */
+        static void deallocate(void *block, std::size_t size) noexcept;
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the pool counters.
+         */
+        static statistics get_statistics();
+
+        /**
+         * @brief Let the calling thread exchange blocks with the global pool shard of a NUMA node. Call it right
+         * after pinning the thread to a CPU of that node, blocks the thread allocates from the heap are then placed
+         * on the node by the first touch. Blocks cached by the thread are handed back to its previous node.
+         *
+         * @param numa_node The NUMA node of the calling thread.
+         */
+        static void set_numa_node(unsigned int numa_node);
+
+        /**
+         * @brief
+         *
+         * @param size The requested size in bytes, at most buffer_pool::max_block_size_.
+         * @return The index of the smallest size class that fits [size] bytes.
+         */
+        static std::size_t size_class(std::size_t size);
+    };
+
+    /**
+     * @brief Stateless allocator on top of buffer_pool, suitable for standard containers.
+     */
+    template<typename T>
+    struct pool_allocator
+    {
+        typedef T value_type;
+
+        pool_allocator() noexcept = default;
+
+        template<typename U>
+        pool_allocator(const pool_allocator<U>& /*other*/) noexcept
+        {
+            /*...*/
+        }
+
+        T *allocate(std::size_t n)
+        {
+            return static_cast<T *>(buffer_pool::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *block, std::size_t n) noexcept
+        {
+            buffer_pool::deallocate(block, n * sizeof(T));
+        }
+    };
+
+    template<typename T, typename U>
+    inline bool operator==(const pool_allocator<T>& /*lhs*/, const pool_allocator<U>& /*rhs*/) noexcept
+    {
+        return true;
+    }
+
+    template<typename T, typename U>
+    inline bool operator!=(const pool_allocator<T>& /*lhs*/, const pool_allocator<U>& /*rhs*/) noexcept
+    {
+        return false;
+    }
+}
+
+#endif
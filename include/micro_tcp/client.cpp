@@ -23,7 +23,9 @@
 ///
 
 #include <micro_tcp/client.hpp>
-#include <micro_tcp/files.hpp>
+#include <micro_tcp/logger.hpp>
+#include <micro_tcp/mapped_file.hpp>
+#include <micro_tcp/local_endpoint.hpp>
 #include <boost/asio/connect.hpp>
 
 namespace micro_tcp
@@ -35,7 +37,11 @@ namespace micro_tcp
             socket_(io_service),
             resolver_(io_service),
             active_session_(nullptr),
-            response_handler_(response_handler)
+            response_handler_(response_handler),
+            protocol_version_(message::default_protocol_version_),
+            max_content_length_(message::default_max_content_length_),
+            transport_(micro_tcp::transport::secure),
+            session_store_(std::make_shared<micro_tcp::tls_session_store>())
     {
         /*...*/
     }
@@ -44,29 +50,50 @@ namespace micro_tcp
 
     void client::connect(const std::string& remote_host, unsigned short remote_port)
     {
-        resolver_.async_resolve({remote_host, std::to_string(remote_port)}, [this](const boost::system::error_code& ec,
-                                                                                   boost::asio::ip::tcp::resolver::iterator result)
+        const auto endpoint = remote_host + ':' + std::to_string(remote_port);
+        resolver_.async_resolve({remote_host, std::to_string(remote_port)}, [this, endpoint](const boost::system::error_code& ec,
+                                                                                             boost::asio::ip::tcp::resolver::iterator result)
         {
             if (!ec)
             {
-                boost::asio::async_connect(socket_, result, [this](boost::system::error_code ec,
-                                                                   boost::asio::ip::tcp::resolver::iterator /*endpoint_connected*/)
+                boost::asio::async_connect(socket_, result, [this, endpoint](boost::system::error_code ec,
+                                                                             boost::asio::ip::tcp::resolver::iterator /*endpoint_connected*/)
                 {
                     if (!ec)
                     {
-                        active_session_ = std::make_shared<client_session>(std::move(socket_), context_, response_handler_);
-                        active_session_->start();
+                        start_session(std::move(socket_), endpoint);
                     }
                     else if (ec != boost::asio::error::connection_aborted)
                     {
-                        std::cerr << __PRETTY_FUNCTION__ << " | " << "Client connection failed"
-                                  << " | Boost asio/system error message: " << ec.message() << '\n';
+                        MICRO_TCP_LOG_ERROR("Client connection failed", ec.message());
                     }
                 });
             }
         });
     }
 
+    bool client::connect_local(const std::string& path)
+    {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        auto socket = std::make_shared<boost::asio::generic::stream_protocol::socket>(io_strand_.get_io_service());
+        socket->async_connect(micro_tcp::make_local_endpoint(path), [this, socket, path](boost::system::error_code ec)
+        {
+            if (!ec)
+            {
+                start_session(std::move(*socket), path);
+            }
+            else
+            {
+                MICRO_TCP_LOG_ERROR("Client connection failed", ec.message());
+            }
+        });
+        return true;
+#else
+        MICRO_TCP_LOG_ERROR("Unix domain sockets are not supported", path);
+        return false;
+#endif
+    }
+
     void client::disconnect()
     {
         if (is_connected())
@@ -76,11 +103,18 @@ namespace micro_tcp
         active_session_.reset();
     }
 
-    bool client::send(const micro_tcp::message& message)
+    bool client::send(const micro_tcp::message& message, client_session::response_callback callback)
     {
+        if (message.get_content_length() > micro_tcp::message::max_content_length(protocol_version_))
+        {
+            MICRO_TCP_LOG_ERROR("CLIENT | Could not send message", "content length of " +
+                                std::to_string(message.get_content_length()) +
+                                " bytes does not fit the header of the protocol version, use protocol_version::v2");
+            return false;
+        }
         if (is_connected())
         {
-            active_session_->send(message);
+            active_session_->send(message, std::move(callback));
             return true;
         }
         return false;
@@ -88,10 +122,12 @@ namespace micro_tcp
 
     bool client::send_file(const std::string& file_path)
     {
-        micro_tcp::message file;
-        if (micro_tcp::read_file(file_path, file))
+        auto file = micro_tcp::mapped_file::open(file_path);
+        if (file)
         {
-            return send(file);
+            micro_tcp::message message;
+            message.set_content_file(std::move(file));
+            return send(message);
         }
         return false;
     }
@@ -100,4 +136,62 @@ namespace micro_tcp
     {
         return active_session_ && active_session_->is_alive();
     }
+
+    void client::set_protocol_version(micro_tcp::protocol_version version)
+    {
+        protocol_version_ = version;
+    }
+
+    micro_tcp::protocol_version client::get_protocol_version() const
+    {
+        return protocol_version_;
+    }
+
+    void client::set_compression_options(const micro_tcp::compression_options& options)
+    {
+        compression_options_ = options;
+    }
+
+    void client::set_max_content_length(std::uint64_t max_content_length)
+    {
+        max_content_length_ = max_content_length;
+    }
+
+    void client::set_transport(micro_tcp::transport transport)
+    {
+        transport_ = transport;
+    }
+
+    micro_tcp::transport client::get_transport() const
+    {
+        return transport_;
+    }
+
+    void client::set_session_resumption(bool enabled)
+    {
+        if (!enabled)
+        {
+            session_store_.reset();
+        }
+        else if (!session_store_)
+        {
+            session_store_ = std::make_shared<micro_tcp::tls_session_store>();
+        }
+    }
+
+    bool client::get_session_resumption() const
+    {
+        return session_store_ != nullptr;
+    }
+
+    void client::start_session(boost::asio::generic::stream_protocol::socket socket, std::string endpoint)
+    {
+        active_session_ = std::make_shared<client_session>(std::move(socket), context_, response_handler_,
+                                                           protocol_version_);
+        active_session_->set_compression_options(compression_options_);
+        active_session_->set_max_content_length(max_content_length_);
+        active_session_->set_transport(transport_);
+        active_session_->set_session_store(session_store_, std::move(endpoint));
+        active_session_->start();
+    }
 }
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include <micro_tcp/client_session.hpp>
 #include <micro_tcp/response_handler.hpp>
+#include <boost/asio/ip/tcp.hpp>
 
 namespace micro_tcp
 {
@@ -67,24 +68,39 @@ namespace micro_tcp
          */
         void connect(const std::string& remote_host, unsigned short remote_port);
 
+        /**
+         * @brief Connect to a server on the same host through a Unix domain stream socket.
+         *
+         * @param path A filesystem path or a name starting with '@' for the abstract namespace (Linux only), see
+         * server::set_local_path().
+         * @return False if Unix domain sockets are not supported on this platform.
+         */
+        bool connect_local(const std::string& path);
+
         /**
          * @brief
          */
         void disconnect();
 
         /**
-         * @brief
+         * @brief Queue a request on the active session. Requests are pipelined: send() may be called again before
+         * the response to an earlier request has arrived.
          *
          * @param message
-         * @return
+         * @param callback Called with the response to this request, see client_session::send().
+         * @return False if the client is not connected or the content is too large for a header of the protocol
+         * version (see message::max_content_length_v1_).
          */
-        bool send(const micro_tcp::message& message);
+        bool send(const micro_tcp::message& message,
+                  client_session::response_callback callback = client_session::response_callback());
 
         /**
-         * @brief
+         * @brief Send a file as message content. The file is memory mapped and streamed in windows of
+         * mapped_file::window_size_ bytes, it is never copied into memory as a whole.
          *
          * @param file_path
-         * @return
+         * @return False if the file could not be opened, is too large for a header of the protocol version or the
+         * client is not connected.
          */
         bool send_file(const std::string& file_path);
 
@@ -94,13 +110,83 @@ namespace micro_tcp
          */
         bool is_connected() const;
 
+        /**
+         * @brief Set the protocol version used by new sessions. Use protocol_version::v1 to talk to servers that
+         * do not support v2 headers. The server always responds in the version of the request.
+         *
+         * @param version The protocol version.
+         */
+        void set_protocol_version(micro_tcp::protocol_version version);
+
+        /**
+         * @brief
+         * @return The protocol version used by new sessions.
+         */
+        micro_tcp::protocol_version get_protocol_version() const;
+
+        /**
+         * @brief Set the compression options of new sessions.
+         *
+         * @param options
+         */
+        void set_compression_options(const micro_tcp::compression_options& options);
+
+        /**
+         * @brief Set the largest response content length new sessions accept, a response claiming more is rejected
+         * and its session stopped. By default message::default_max_content_length_.
+         *
+         * @param max_content_length The largest content length in bytes.
+         */
+        void set_max_content_length(std::uint64_t max_content_length);
+
+        /**
+         * @brief Set the transport of new sessions, by default SSL/TLS. The server MUST use the same transport.
+         *
+         * @param transport The transport.
+         */
+        void set_transport(micro_tcp::transport transport);
+
+        /**
+         * @brief
+         * @return The transport of new sessions.
+         */
+        micro_tcp::transport get_transport() const;
+
+        /**
+         * @brief Reuse the SSL/TLS session of the previous connection to the same endpoint, so reconnecting takes an
+         * abbreviated handshake. Enabled by default, disabling it forgets the stored sessions.
+         *
+         * @param enabled
+         */
+        void set_session_resumption(bool enabled);
+
+        /**
+         * @brief
+         * @return True if new sessions resume stored SSL/TLS sessions.
+         */
+        bool get_session_resumption() const;
+
     private:
+        /**
+         * @brief Start a session on a connected socket.
+         *
+         * @param socket
+         * @param endpoint The remote endpoint, the key of its SSL/TLS session in client::session_store_.
+         */
+        void start_session(boost::asio::generic::stream_protocol::socket socket, std::string endpoint);
+
+
         boost::asio::ssl::context& context_;
         boost::asio::io_service::strand io_strand_;
         boost::asio::ip::tcp::socket socket_;
         boost::asio::ip::tcp::resolver resolver_;
         micro_tcp::client_session_ptr active_session_;
         micro_tcp::response_handler& response_handler_;
+        micro_tcp::protocol_version protocol_version_;
+        micro_tcp::compression_options compression_options_;
+        std::uint64_t max_content_length_;
+        micro_tcp::transport transport_;
+        std::shared_ptr<micro_tcp::tls_session_store> session_store_; /*!< Null if session resumption is disabled. */
     };
 }
 
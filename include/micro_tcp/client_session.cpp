@@ -23,102 +23,158 @@
 ///
 
 #include <micro_tcp/client_session.hpp>
+#include <micro_tcp/logger.hpp>
 
 namespace micro_tcp
 {
-    client_session::client_session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context,
-                                   micro_tcp::response_handler& response_handler) :
+    /*static*/constexpr int client_session::default_timeout_ms;
+
+    client_session::client_session(boost::asio::generic::stream_protocol::socket socket,
+                                   boost::asio::ssl::context& context, micro_tcp::response_handler& response_handler,
+                                   micro_tcp::protocol_version version) :
             session(std::move(socket), context),
             response_handler_(response_handler),
-            timeout_(io_strand_.get_io_service())
+            read_in_progress_(false),
+            next_request_id_(1)
     {
-        /*...*/
+        set_protocol_version(version);
+        const std::chrono::milliseconds timeout(default_timeout_ms);
+        set_timeouts({timeout, std::chrono::milliseconds::zero(), timeout, timeout});
     }
 
     void client_session::start()
     {
+        if (session_store_ && secure_stream_.is_enabled())
+        {
+            session_store_->apply(secure_stream_.secure_stream().native_handle(), endpoint_);
+        }
         do_secure_handshake(boost::asio::ssl::stream_base::client);
     }
 
-    void client_session::send(const micro_tcp::message& message)
+    void client_session::send(const micro_tcp::message& message, response_callback callback)
     {
-        write_buffer_ = message;
-        write_buffer_.prepare_header_buffer_write();
-        do_write_header();
+        auto self(shared_from_this());
+        io_strand_.dispatch([this, self, request = micro_tcp::message(message), callback]() mutable
+        {
+            request.request_id_ = next_request_id_++;
+            pending_responses_.emplace(request.request_id_, std::move(callback));
+            enqueue_write(std::move(request));
+            if (!read_in_progress_)
+            {
+                read_in_progress_ = true;
+                read_buffer_.prepare_header_buffer_read();
+                do_read_header();
+            }
+        });
+    }
+
+    void client_session::set_session_store(std::shared_ptr<micro_tcp::tls_session_store> store, std::string endpoint)
+    {
+        session_store_ = std::move(store);
+        endpoint_ = std::move(endpoint);
     }
 
     void client_session::on_secure_handshake()
     {
-        debug("CLIENT | secure handshake OK");
-        //do_timeout();
+        MICRO_TCP_LOG_INFO("CLIENT | secure handshake OK");
+        if (session_store_ && secure_stream_.is_enabled())
+        {
+            session_store_->save(secure_stream_.secure_stream().native_handle(), endpoint_);
+        }
     }
 
     void client_session::on_write_header()
     {
-        debug("CLIENT | write request header OK");
-        write_buffer_.prepare_content_buffer_write();
-        do_write_content();
+        MICRO_TCP_LOG_DEBUG("CLIENT | write request header OK");
     }
 
     void client_session::on_write_content()
     {
-        debug("CLIENT | write request content OK");
-        read_buffer_.prepare_header_buffer_read();
-        do_read_header();
+        MICRO_TCP_LOG_DEBUG("CLIENT | write request content OK");
     }
 
     void client_session::on_read_header()
     {
-        debug("CLIENT | read response header OK");
+        if (!read_buffer_.is_valid_header(max_content_length_))
+        {
+            MICRO_TCP_LOG_WARNING("CLIENT | Rejected response header", "invalid header or content length too large");
+            stop();
+            return;
+        }
+        MICRO_TCP_LOG_DEBUG("CLIENT | read response header OK");
+        read_buffer_.decode_header_fields();
+        const auto content_length = read_buffer_.get_header_buffer_content_length();
+        if (!(read_buffer_.flags_ & compression::compressed_flag))
+        {
+            content_sink_ = response_handler_.open_content_sink(read_buffer_, content_length);
+        }
+        if (content_sink_)
+        {
+            read_buffer_.clear_content_buffer();
+            do_read_content_to_sink(content_length);
+            return;
+        }
         read_buffer_.prepare_content_buffer_read();
         do_read_content();
     }
 
     void client_session::on_read_content()
     {
-        debug("CLIENT | read response content OK");
-        response_handler_.handle_response(read_buffer_);
+        MICRO_TCP_LOG_DEBUG("CLIENT | read response content OK");
+        response_callback callback;
+        auto pending = (protocol_version_ == protocol_version::v1) ? pending_responses_.begin()
+                                                                    : pending_responses_.find(read_buffer_.request_id_);
+        if (pending != pending_responses_.end())
+        {
+            callback = std::move(pending->second);
+            pending_responses_.erase(pending);
+        }
+        else
+        {
+            MICRO_TCP_LOG_WARNING("CLIENT | Received response for an unknown request", std::to_string(read_buffer_.request_id_));
+        }
+        if (content_sink_)
+        {
+            response_handler_.handle_response(read_buffer_, *content_sink_);
+            content_sink_.reset();
+            if (callback)
+            {
+                callback(read_buffer_);
+            }
+        }
+        else if (callback)
+        {
+            callback(read_buffer_);
+        }
+        else
+        {
+            response_handler_.handle_response(read_buffer_);
+        }
         read_buffer_.clear();
-        write_buffer_.clear();
-        //set_timeout_expiry_time();
+        read_buffer_.prepare_header_buffer_read();
+        if (!pending_responses_.empty())
+        {
+            do_read_header();
+        }
+        else
+        {
+            read_in_progress_ = false;
+        }
     }
 
     void client_session::on_shutdown_secure_stream()
     {
-        debug("CLIENT | shutting down secure (SSL/TLS) protocol on stream OK");
+        MICRO_TCP_LOG_INFO("CLIENT | shutting down secure (SSL/TLS) protocol on stream OK");
         do_close_socket();
     }
 
     void client_session::on_close_socket()
     {
-        debug("CLIENT | socket close OK");
-    }
-
-    void client_session::do_timeout()
-    {
-        timeout_.async_wait(io_strand_.wrap([this](const boost::system::error_code& ec)
-        {
-            if (!ec)
-            {
-                stop();
-            }
-            else if (ec != boost::asio::error::operation_aborted)
-            {
-                debug("async_wait failed", ec.message());
-            }
-        }));
-    }
-
-    void client_session::set_timeout_expiry_time(unsigned long timeout_ms)
-    {
-        boost::system::error_code ec;
-        if (timeout_.expires_from_now(boost::posix_time::seconds(timeout_ms), ec) > 0)
-        {
-            do_timeout();
-        }
-        else
+        MICRO_TCP_LOG_INFO("CLIENT | socket close OK");
+        if (session_store_ && secure_stream_.is_enabled())
         {
-            debug("timer has already expired or was never started at all", " ");
+            // TLS 1.3 tickets arrive after the handshake, store the session again once they have been read.
+            session_store_->save(secure_stream_.secure_stream().native_handle(), endpoint_);
         }
     }
 }
\ No newline at end of file
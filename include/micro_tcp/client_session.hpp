@@ -27,19 +27,31 @@
 
 #include <micro_tcp/session.hpp>
 #include <micro_tcp/response_handler.hpp>
-#include <boost/asio/deadline_timer.hpp>
+#include <micro_tcp/tls_resumption.hpp>
+#include <functional>
+#include <map>
 
 namespace micro_tcp
 {
     /**
      * @brief
      */
-    class client_session :
+    class client_session final :
             public session
     {
     public:
+        /**
+         * @brief Default deadline (see session::timeouts) of the handshake and of a response to arrive without
+         * stalling once it has started. The idle deadline is disabled: the client only reads while responses are
+         * pending, and a request may take the server as long as its handler needs.
+         */
         static constexpr auto default_timeout_ms = 10000;
 
+        /**
+         * @brief Callback for the response of a single request.
+         */
+        typedef std::function<void(const micro_tcp::message&)> response_callback;
+
         /**
          * @brief Non-copyable - delete copy constructor.
          */
@@ -56,9 +68,11 @@ namespace micro_tcp
          * @param socket
          * @param context
          * @param response_handler
+         * @param version The protocol version used for requests, the server responds in the same version.
          */
-        explicit client_session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context,
-                                micro_tcp::response_handler& response_handler);
+        explicit client_session(boost::asio::generic::stream_protocol::socket socket,
+                                boost::asio::ssl::context& context, micro_tcp::response_handler& response_handler,
+                                micro_tcp::protocol_version version = message::default_protocol_version_);
 
         /**
          * @brief
@@ -66,11 +80,26 @@ namespace micro_tcp
         void start() override;
 
         /**
-         * @brief
+         * @brief Queue a request. May be called from any thread and does not wait for earlier requests to be
+         * answered: requests are written back-to-back. With protocol_version::v2 every request gets a request id and
+         * responses are matched by id, in whatever order the server completes them. With protocol_version::v1
+         * responses are matched in order of arrival.
+         *
+         * @param message The request.
+         * @param callback Called with the response to this request. If empty, the response is passed to the
+         * response_handler. A response streamed to a content sink is first passed to the response_handler together
+         * with the closed sink, the callback is then called with the response, whose content buffer is empty.
+         */
+        void send(const micro_tcp::message& message, response_callback callback = response_callback());
+
+        /**
+         * @brief Resume the SSL/TLS session stored for the remote endpoint, and store the session negotiated by this
+         * one. Call it before client_session::start().
          *
-         * @param message
+         * @param store The session store, or nullptr to always do a full handshake.
+         * @param endpoint The remote endpoint the session is stored under, e.g. host:port.
          */
-        void send(const micro_tcp::message& message);
+        void set_session_store(std::shared_ptr<micro_tcp::tls_session_store> store, std::string endpoint);
 
     private:
         /**
@@ -108,19 +137,13 @@ namespace micro_tcp
          */
         void on_close_socket() override;
 
-        /**
-         * @brief
-         */
-        void do_timeout();
-
-        /**
-         * @brief
-         */
-        void set_timeout_expiry_time(unsigned long timeout_ms = default_timeout_ms);
-
     private:
         micro_tcp::response_handler& response_handler_;
-        boost::asio::deadline_timer timeout_;
+        std::shared_ptr<micro_tcp::tls_session_store> session_store_;
+        std::string endpoint_; /*!< Key of the session in client_session::session_store_. */
+        std::map<std::uint64_t, response_callback> pending_responses_; /*!< Requests awaiting a response, by id. */
+        bool read_in_progress_; /*!< True while a response is being read. */
+        std::uint64_t next_request_id_; /*!< Request id of the next request. */
     };
 
     typedef std::shared_ptr<client_session> client_session_ptr;
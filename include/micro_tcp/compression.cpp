@@ -0,0 +1,280 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/compression.hpp>
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#ifdef MICRO_TCP_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MICRO_TCP_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef MICRO_TCP_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace micro_tcp
+{
+    namespace
+    {
+        constexpr std::size_t length_prefix_size = sizeof(std::uint64_t);
+        constexpr unsigned int codec_flag_shift = 4;
+
+        /**
+         * @brief Codecs in order of preference when the preferred codec is not available: fastest first.
+         */
+        constexpr compression_codec codec_preference[] = {compression_codec::lz4, compression_codec::zstd,
+                                                          compression_codec::zlib};
+
+        constexpr std::uint16_t codec_bit(compression_codec codec)
+        {
+            return static_cast<std::uint16_t>(1u << static_cast<unsigned int>(codec));
+        }
+
+        compression_codec default_codec()
+        {
+            return compression::select_codec(compression_codec::lz4, compression::supported_codecs());
+        }
+    }
+
+    /*static*/constexpr std::size_t compression_options::default_threshold_;
+    /*static*/constexpr std::size_t compression_options::default_max_size_;
+
+    compression_options::compression_options() :
+            codec_(default_codec()),
+            threshold_(default_threshold_),
+            max_size_(default_max_size_)
+    {
+        /*...*/
+    }
+
+    compression_options::compression_options(compression_codec codec, std::size_t threshold, std::size_t max_size) :
+            codec_(codec),
+            threshold_(threshold),
+            max_size_(max_size)
+    {
+        /*...*/
+    }
+
+    namespace compression
+    {
+        std::uint16_t supported_codecs()
+        {
+            std::uint16_t codecs = 0;
+#ifdef MICRO_TCP_WITH_ZLIB
+            codecs |= codec_bit(compression_codec::zlib);
+#endif
+#ifdef MICRO_TCP_WITH_LZ4
+            codecs |= codec_bit(compression_codec::lz4);
+#endif
+#ifdef MICRO_TCP_WITH_ZSTD
+            codecs |= codec_bit(compression_codec::zstd);
+#endif
+            return codecs;
+        }
+
+        compression_codec select_codec(compression_codec preferred, std::uint16_t peer_codecs)
+        {
+            const auto codecs = static_cast<std::uint16_t>(supported_codecs() & peer_codecs);
+            if (preferred == compression_codec::none || codecs == 0)
+            {
+                return compression_codec::none;
+            }
+            if (codecs & codec_bit(preferred))
+            {
+                return preferred;
+            }
+            for (const auto codec : codec_preference)
+            {
+                if (codecs & codec_bit(codec))
+                {
+                    return codec;
+                }
+            }
+            return compression_codec::none;
+        }
+
+        bool compress(compression_codec codec, const char *data, std::size_t size, message::buffer_type& output)
+        {
+            const auto length = boost::endian::native_to_little(static_cast<std::uint64_t>(size));
+            static_cast<void>(data); /* Unused if no codec is available */
+            switch (codec)
+            {
+#ifdef MICRO_TCP_WITH_LZ4
+                case compression_codec::lz4:
+                {
+                    if (size > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE))
+                    {
+                        return false;
+                    }
+                    const auto bound = LZ4_compressBound(static_cast<int>(size));
+                    output.resize(length_prefix_size + static_cast<std::size_t>(bound));
+                    const auto compressed = LZ4_compress_default(data, output.data() + length_prefix_size,
+                                                                 static_cast<int>(size), bound);
+                    if (compressed <= 0)
+                    {
+                        return false;
+                    }
+                    output.resize(length_prefix_size + static_cast<std::size_t>(compressed));
+                    break;
+                }
+#endif
+#ifdef MICRO_TCP_WITH_ZSTD
+                case compression_codec::zstd:
+                {
+                    const auto bound = ZSTD_compressBound(size);
+                    output.resize(length_prefix_size + bound);
+                    const auto compressed = ZSTD_compress(output.data() + length_prefix_size, bound, data, size, 1);
+                    if (ZSTD_isError(compressed))
+                    {
+                        return false;
+                    }
+                    output.resize(length_prefix_size + compressed);
+                    break;
+                }
+#endif
+#ifdef MICRO_TCP_WITH_ZLIB
+                case compression_codec::zlib:
+                {
+                    if (size > std::numeric_limits<uLong>::max())
+                    {
+                        return false;
+                    }
+                    auto compressed = compressBound(static_cast<uLong>(size));
+                    output.resize(length_prefix_size + compressed);
+                    if (compress2(reinterpret_cast<Bytef *>(output.data() + length_prefix_size), &compressed,
+                                  reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size), Z_BEST_SPEED) != Z_OK)
+                    {
+                        return false;
+                    }
+                    output.resize(length_prefix_size + compressed);
+                    break;
+                }
+#endif
+                default:
+                    return false;
+            }
+            std::memcpy(output.data(), &length, sizeof(length));
+            return true;
+        }
+
+        bool decompress(compression_codec codec, const char *data, std::size_t size, std::uint64_t max_length,
+                        message::buffer_type& output)
+        {
+            if (size < length_prefix_size)
+            {
+                return false;
+            }
+            std::uint64_t length;
+            std::memcpy(&length, data, sizeof(length));
+            length = boost::endian::little_to_native(length);
+            if (length > max_length || length > std::numeric_limits<std::size_t>::max())
+            {
+                return false;
+            }
+            output.resize(static_cast<std::size_t>(length));
+            data += length_prefix_size;
+            size -= length_prefix_size;
+            switch (codec)
+            {
+#ifdef MICRO_TCP_WITH_LZ4
+                case compression_codec::lz4:
+                {
+                    if (size > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE)
+                        || length > static_cast<std::uint64_t>(LZ4_MAX_INPUT_SIZE))
+                    {
+                        return false;
+                    }
+                    return LZ4_decompress_safe(data, output.data(), static_cast<int>(size),
+                                               static_cast<int>(length)) == static_cast<int>(length);
+                }
+#endif
+#ifdef MICRO_TCP_WITH_ZSTD
+                case compression_codec::zstd:
+                {
+                    const auto decompressed = ZSTD_decompress(output.data(), output.size(), data, size);
+                    return !ZSTD_isError(decompressed) && decompressed == length;
+                }
+#endif
+#ifdef MICRO_TCP_WITH_ZLIB
+                case compression_codec::zlib:
+                {
+                    if (size > std::numeric_limits<uLong>::max() || length > std::numeric_limits<uLong>::max())
+                    {
+                        return false;
+                    }
+                    auto decompressed = static_cast<uLong>(length);
+                    return uncompress(reinterpret_cast<Bytef *>(output.data()), &decompressed,
+                                      reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size)) == Z_OK
+                           && decompressed == length;
+                }
+#endif
+                default:
+                    return false;
+            }
+        }
+
+        void compress_content(micro_tcp::message& message, const compression_options& options,
+                              std::uint16_t peer_codecs, message::buffer_type& scratch)
+        {
+            message.accepted_codecs_ = supported_codecs();
+            message.flags_ = static_cast<std::uint8_t>(message.flags_ & ~compressed_flag & 0x0F);
+            if (message.content_buffer_.size() < options.threshold_ || message.content_buffer_.size() > options.max_size_
+                || message.version_ != protocol_version::v2
+                || message.content_file_)
+            {
+                return;
+            }
+            const auto codec = select_codec(options.codec_, peer_codecs);
+            if (codec != compression_codec::none
+                && compress(codec, message.content_buffer_.data(), message.content_buffer_.size(), scratch)
+                && scratch.size() < message.content_buffer_.size())
+            {
+                std::swap(message.content_buffer_, scratch);
+                message.flags_ = static_cast<std::uint8_t>(message.flags_ | compressed_flag
+                                                           | (static_cast<unsigned int>(codec) << codec_flag_shift));
+            }
+        }
+
+        bool decompress_content(micro_tcp::message& message, std::uint64_t max_length, message::buffer_type& scratch)
+        {
+            if (!(message.flags_ & compressed_flag))
+            {
+                return true;
+            }
+            const auto codec = static_cast<compression_codec>(message.flags_ >> codec_flag_shift);
+            if (!decompress(codec, message.content_buffer_.data(), message.content_buffer_.size(), max_length, scratch))
+            {
+                return false;
+            }
+            std::swap(message.content_buffer_, scratch);
+            message.flags_ = static_cast<std::uint8_t>(message.flags_ & ~compressed_flag & 0x0F);
+            return true;
+        }
+    }
+}
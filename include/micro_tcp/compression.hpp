@@ -0,0 +1,153 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_COMPRESSION_HPP
+#define MICRO_TCP_COMPRESSION_HPP
+
+#include <micro_tcp/buffer_pool.hpp>
+#include <micro_tcp/message.hpp>
+#include <cstdint>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Codec used to compress the content of a message. The codecs that are available depend on the
+     * libraries found at build time (MICRO_TCP_WITH_LZ4, MICRO_TCP_WITH_ZSTD and MICRO_TCP_WITH_ZLIB).
+     */
+    enum class compression_codec : std::uint8_t
+    {
+        none = 0,
+        zlib = 1,
+        lz4 = 2,
+        zstd = 3
+    };
+
+    /**
+     * @brief Compression settings of a session.
+     *
+     * Every v2 header advertises the codecs the sender can decode. A session compresses the content of an outgoing
+     * message only if it is at least compression_options::threshold_ bytes and the peer has advertised a codec,
+     * preferably compression_options::codec_. Small messages never pay more than a size check. Content larger than
+     * compression_options::max_size_ is sent uncompressed: a compressed message is decompressed in memory as a whole,
+     * while uncompressed content can be streamed to a file_sink by the receiver.
+     */
+    struct compression_options
+    {
+        /**
+         * @brief Content smaller than this amount of bytes is never compressed.
+         */
+        static constexpr std::size_t default_threshold_ = 4096;
+
+        /**
+         * @brief Content larger than this amount of bytes is never compressed, by default the largest pooled buffer.
+         */
+        static constexpr std::size_t default_max_size_ = buffer_pool::max_block_size_;
+
+        /**
+         * @brief Defaults to the fastest codec available, compression_options::default_threshold_ and
+         * compression_options::default_max_size_.
+         */
+        compression_options();
+
+        /**
+         * @brief
+         *
+         * @param codec The preferred codec, compression_codec::none disables compression of outgoing messages.
+         * @param threshold Content smaller than this amount of bytes is never compressed.
+         * @param max_size Content larger than this amount of bytes is never compressed.
+         */
+        compression_options(compression_codec codec, std::size_t threshold, std::size_t max_size = default_max_size_);
+
+        compression_codec codec_;
+        std::size_t threshold_;
+        std::size_t max_size_;
+    };
+
+    namespace compression
+    {
+        /**
+         * @brief Message flag: the content is compressed. The codec is stored in the upper four flag bits.
+         */
+        constexpr std::uint8_t compressed_flag = 0x01;
+
+        /**
+         * @brief
+         *
+         * @return Bit mask with bit (1 << codec) set for every codec that this build can compress and decompress.
+         */
+        std::uint16_t supported_codecs();
+
+        /**
+         * @brief Select the codec to compress with for a peer.
+         *
+         * @param preferred The preferred codec.
+         * @param peer_codecs The codecs advertised by the peer.
+         * @return The preferred codec if both sides support it, otherwise the fastest codec both sides support or
+         * compression_codec::none.
+         */
+        compression_codec select_codec(compression_codec preferred, std::uint16_t peer_codecs);
+
+        /**
+         * @brief Compress [size] bytes into output: the uncompressed length (unsigned 64-bit little-endian) followed
+         * by the compressed bytes.
+         *
+         * @return False if the codec is not supported or compression failed.
+         */
+        bool compress(compression_codec codec, const char *data, std::size_t size, message::buffer_type& output);
+
+        /**
+         * @brief Decompress content produced by compression::compress() into output. The uncompressed length prefix
+         * is checked against max_length before output is allocated.
+         *
+         * @return False if the codec is not supported, the content is corrupt or it decompresses to more than
+         * max_length bytes.
+         */
+        bool decompress(compression_codec codec, const char *data, std::size_t size, std::uint64_t max_length,
+                        message::buffer_type& output);
+
+        /**
+         * @brief Compress the content buffer of a message in place if the options and peer allow it and it saves
+         * space. Sets the compressed flag and codec in message::flags_.
+         *
+         * @param message The message, its header must be prepared afterwards.
+         * @param options The compression options of the session.
+         * @param peer_codecs The codecs advertised by the peer.
+         * @param scratch Reusable scratch buffer, swapped with the content buffer on success.
+         */
+        void compress_content(micro_tcp::message& message, const compression_options& options,
+                              std::uint16_t peer_codecs, message::buffer_type& scratch);
+
+        /**
+         * @brief Decompress the content buffer of a message in place if its compressed flag is set.
+         *
+         * @param message The message.
+         * @param max_length The largest decompressed content length accepted, see session::set_max_content_length().
+         * @param scratch Reusable scratch buffer, swapped with the content buffer on success.
+         * @return False if the content could not be decompressed.
+         */
+        bool decompress_content(micro_tcp::message& message, std::uint64_t max_length, message::buffer_type& scratch);
+    }
+}
+
+#endif
@@ -0,0 +1,214 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/coroutine_session.hpp>
+
+#if defined(MICRO_TCP_WITH_COROUTINES) && defined(__cpp_impl_coroutine)
+
+#include <micro_tcp/logger.hpp>
+#include <exception>
+#include <utility>
+
+namespace micro_tcp
+{
+    void session_task::promise_type::final_awaiter::await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+    {
+        auto session = std::move(coroutine.promise().session_);
+        const auto stopped = coroutine.promise().stopped_;
+        coroutine.destroy();
+        if (session && !stopped && session->is_alive())
+        {
+            session->stop();
+        }
+    }
+
+    void session_task::promise_type::unhandled_exception() noexcept
+    {
+        try
+        {
+            throw;
+        }
+        catch (const std::exception& exception)
+        {
+            MICRO_TCP_LOG_ERROR("COROUTINE | run() exited with an exception", exception.what());
+        }
+        catch (...)
+        {
+            MICRO_TCP_LOG_ERROR("COROUTINE | run() exited with an exception", "unknown exception");
+        }
+        if (session_ && session_->is_alive())
+        {
+            session_->stop();
+            stopped_ = true;
+        }
+    }
+
+    bool coroutine_session::read_awaiter::await_ready() const noexcept
+    {
+        return session_.closed_;
+    }
+
+    bool coroutine_session::read_awaiter::await_suspend(std::coroutine_handle<> coroutine)
+    {
+        session_.reader_ = coroutine;
+        session_.read_completed_ = false;
+        session_.read_suspending_ = true;
+        session_.read_buffer_.prepare_header_buffer_read();
+        session_.do_read_header();
+        session_.read_suspending_ = false;
+        if (session_.read_completed_)
+        {
+            session_.reader_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<micro_tcp::message> coroutine_session::read_awaiter::await_resume()
+    {
+        return std::exchange(session_.read_result_, std::nullopt);
+    }
+
+    bool coroutine_session::write_awaiter::await_ready() const noexcept
+    {
+        return session_.closed_;
+    }
+
+    void coroutine_session::write_awaiter::await_suspend(std::coroutine_handle<> coroutine)
+    {
+        session_.writer_ = coroutine;
+        session_.enqueue_write(std::move(message_));
+    }
+
+    bool coroutine_session::write_awaiter::await_resume() noexcept
+    {
+        return std::exchange(session_.write_result_, false);
+    }
+
+    coroutine_session::coroutine_session(boost::asio::generic::stream_protocol::socket socket,
+                                         boost::asio::ssl::context& context,
+                                         boost::asio::ssl::stream_base::handshake_type type,
+                                         micro_tcp::protocol_version version) :
+            session(std::move(socket), context),
+            handshake_type_(type),
+            read_suspending_(false),
+            read_completed_(false),
+            write_result_(false),
+            closed_(false)
+    {
+        set_protocol_version(version);
+    }
+
+    void coroutine_session::start()
+    {
+        do_secure_handshake(handshake_type_);
+    }
+
+    coroutine_session::read_awaiter coroutine_session::read_message()
+    {
+        return {*this};
+    }
+
+    coroutine_session::write_awaiter coroutine_session::write_message(micro_tcp::message message)
+    {
+        return {*this, std::move(message)};
+    }
+
+    void coroutine_session::on_secure_handshake()
+    {
+        MICRO_TCP_LOG_INFO("COROUTINE | secure handshake OK");
+        run();
+    }
+
+    void coroutine_session::on_read_header()
+    {
+        if (!read_buffer_.is_valid_header(max_content_length_))
+        {
+            MICRO_TCP_LOG_WARNING("COROUTINE | Rejected message header", "invalid header or content length too large");
+            stop();
+            return;
+        }
+        read_buffer_.decode_header_fields();
+        read_buffer_.prepare_content_buffer_read();
+        do_read_content();
+    }
+
+    void coroutine_session::on_read_content()
+    {
+        complete_read(std::move(read_buffer_));
+    }
+
+    void coroutine_session::on_write_header()
+    {
+        /*...*/
+    }
+
+    void coroutine_session::on_write_content()
+    {
+        complete_write_message(true);
+    }
+
+    void coroutine_session::on_shutdown_secure_stream()
+    {
+        do_close_socket();
+    }
+
+    void coroutine_session::on_close_socket()
+    {
+        MICRO_TCP_LOG_INFO("COROUTINE | socket close OK");
+        closed_ = true;
+        if (reader_)
+        {
+            complete_read(std::nullopt);
+        }
+        if (writer_)
+        {
+            complete_write_message(false);
+        }
+    }
+
+    void coroutine_session::complete_read(std::optional<micro_tcp::message> message)
+    {
+        read_result_ = std::move(message);
+        if (read_suspending_)
+        {
+            read_completed_ = true;
+        }
+        else if (reader_)
+        {
+            std::exchange(reader_, nullptr).resume();
+        }
+    }
+
+    void coroutine_session::complete_write_message(bool written)
+    {
+        write_result_ = written;
+        if (writer_)
+        {
+            std::exchange(writer_, nullptr).resume();
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,264 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_COROUTINE_SESSION_HPP
+#define MICRO_TCP_COROUTINE_SESSION_HPP
+
+#if defined(MICRO_TCP_WITH_COROUTINES) && defined(__cpp_impl_coroutine)
+
+#include <micro_tcp/session.hpp>
+#include <coroutine>
+#include <optional>
+
+namespace micro_tcp
+{
+    class coroutine_session;
+
+    /**
+     * @brief Return type of coroutine_session::run(). The coroutine starts eagerly and is detached: its frame owns
+     * the session and is destroyed when the coroutine returns, after which the session is stopped.
+     */
+    class session_task
+    {
+    public:
+        struct promise_type
+        {
+            /**
+             * @brief Bind the coroutine frame to the session it is a member function of.
+             *
+             * @param session The session (implicit object parameter of coroutine_session::run()).
+             */
+            template<typename Session, typename... Args>
+            explicit promise_type(Session& session, Args&...);
+
+            session_task get_return_object() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            /**
+             * @brief Destroys the frame, then stops the session if it is still alive and was not stopped by
+             * promise_type::unhandled_exception().
+             */
+            struct final_awaiter
+            {
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept;
+
+                void await_resume() noexcept
+                {
+                    /*...*/
+                }
+            };
+
+            final_awaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void() noexcept
+            {
+                /*...*/
+            }
+
+            /**
+             * @brief Log the exception that escaped coroutine_session::run() and stop the session, so its socket is
+             * not left open without a reader.
+             */
+            void unhandled_exception() noexcept;
+
+            std::shared_ptr<micro_tcp::coroutine_session> session_; /*!< Keeps the session alive while the coroutine runs. */
+            bool stopped_ = false; /*!< True if the session was stopped by unhandled_exception(). */
+        };
+    };
+
+    /**
+     * @brief A session whose protocol is written as a single coroutine instead of a chain of callbacks. After the
+     * secure handshake coroutine_session::run() is started on the strand of the session and awaits whole messages:
+     *
+     * @code
+     * micro_tcp::session_task run() override
+     * {
+     *     while (auto request = co_await read_message())
+     *     {
+     *         micro_tcp::message response;
+     *         response.request_id_ = request->request_id_;
+     *         if (!co_await write_message(std::move(response)))
+     *         {
+     *             break;
+     *         }
+     *     }
+     * }
+     * @endcode
+     *
+     * Both awaiters live in the coroutine frame and store nothing but the coroutine handle in the session, so an
+     * operation allocates no handler and copies no shared_ptr beyond what the session itself does on the stream.
+     * A read that completes from buffered data continues the coroutine without suspending it. At most one
+     * read and one write may be awaited at a time; run() must only await from within the strand of the session.
+     *
+     * Only available if built with MICRO_TCP_WITH_COROUTINES (C++20).
+     */
+    class coroutine_session :
+            public session
+    {
+    public:
+        /**
+         * @brief Awaiter of coroutine_session::read_message().
+         */
+        struct read_awaiter
+        {
+            bool await_ready() const noexcept;
+
+            bool await_suspend(std::coroutine_handle<> coroutine);
+
+            std::optional<micro_tcp::message> await_resume();
+
+            micro_tcp::coroutine_session& session_;
+        };
+
+        /**
+         * @brief Awaiter of coroutine_session::write_message().
+         */
+        struct write_awaiter
+        {
+            bool await_ready() const noexcept;
+
+            void await_suspend(std::coroutine_handle<> coroutine);
+
+            bool await_resume() noexcept;
+
+            micro_tcp::coroutine_session& session_;
+            micro_tcp::message message_;
+        };
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        coroutine_session(const coroutine_session&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        coroutine_session& operator=(const coroutine_session&) = delete;
+
+        /**
+         * @brief
+         *
+         * @param socket
+         * @param context
+         * @param type Handshake as a server or client.
+         * @param version The protocol version of all incoming and outgoing messages.
+         */
+        explicit coroutine_session(boost::asio::generic::stream_protocol::socket socket,
+                                   boost::asio::ssl::context& context,
+                                   boost::asio::ssl::stream_base::handshake_type type,
+                                   micro_tcp::protocol_version version = message::default_protocol_version_);
+
+        /**
+         * @brief Perform the secure handshake and start coroutine_session::run().
+         */
+        void start() override;
+
+        /**
+         * @brief Read the next message.
+         *
+         * @return An awaiter yielding the message, or std::nullopt once the session has been closed.
+         */
+        read_awaiter read_message();
+
+        /**
+         * @brief Write a message. Its request id is left as is.
+         *
+         * @param message The message to write.
+         * @return An awaiter yielding true once the message is on the stream, or false once the session has been
+         * closed.
+         */
+        write_awaiter write_message(micro_tcp::message message);
+
+    protected:
+        /**
+         * @brief The protocol of the session. Started once after a successful secure handshake. The session is
+         * stopped when it returns.
+         */
+        virtual micro_tcp::session_task run() = 0;
+
+        void on_secure_handshake() final;
+
+        void on_read_header() final;
+
+        void on_read_content() final;
+
+        void on_write_header() final;
+
+        void on_write_content() final;
+
+        void on_shutdown_secure_stream() final;
+
+        void on_close_socket() final;
+
+    private:
+        /**
+         * @brief Resume (or, from within await_suspend(), just complete) the awaited read.
+         *
+         * @param message The message read, or std::nullopt if the session has been closed.
+         */
+        void complete_read(std::optional<micro_tcp::message> message);
+
+        /**
+         * @brief Resume the awaited write.
+         *
+         * @param written True if the message is on the stream.
+         */
+        void complete_write_message(bool written);
+
+        boost::asio::ssl::stream_base::handshake_type handshake_type_;
+        std::coroutine_handle<> reader_; /*!< Coroutine awaiting a read, if any. */
+        std::coroutine_handle<> writer_; /*!< Coroutine awaiting a write, if any. */
+        bool read_suspending_; /*!< True while a read is started from read_awaiter::await_suspend(). */
+        bool read_completed_; /*!< True if the awaited read completed while suspending. */
+        bool write_result_; /*!< Result of the last awaited write. */
+        bool closed_; /*!< True once the socket has been closed. */
+        std::optional<micro_tcp::message> read_result_; /*!< Result of the last awaited read. */
+    };
+
+    template<typename Session, typename... Args>
+    session_task::promise_type::promise_type(Session& session, Args&...) :
+            session_(std::static_pointer_cast<micro_tcp::coroutine_session>(session.shared_from_this()))
+    {
+        /*...*/
+    }
+}
+
+#endif
+
+#endif
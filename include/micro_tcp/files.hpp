@@ -26,11 +26,135 @@
 #define MICRO_TCP_FILES_HPP
 
 #include <micro_tcp/message.hpp>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 
 namespace micro_tcp
 {
+    /**
+     * @brief Unbuffered output file that received content is written to chunk by chunk as it arrives, so the
+     * content never has to be held in memory as a whole.
+     */
+    class file_sink
+    {
+    public:
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        file_sink(const file_sink&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        file_sink& operator=(const file_sink&) = delete;
+
+        file_sink() :
+                file_(nullptr),
+                size_(0)
+        {
+            /*...*/
+        }
+
+        /**
+         * @brief Closes the file (if still open).
+         */
+        ~file_sink()
+        {
+            close();
+        }
+
+        /**
+         * @brief Create or truncate the file at file_path. Writes go straight to the file descriptor.
+         *
+         * @param file_path
+         * @return True if the file was opened.
+         */
+        bool open(const std::string& file_path)
+        {
+            close();
+            path_ = file_path;
+            size_ = 0;
+            file_ = std::fopen(file_path.c_str(), "wb");
+            if (file_ && std::setvbuf(file_, nullptr, _IONBF, 0) == 0)
+            {
+                return true;
+            }
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The file (" << file_path << ") could not be opened!\n";
+            close();
+            return false;
+        }
+
+        /**
+         * @brief
+         *
+         * @param data
+         * @param size
+         * @return True if all bytes were written.
+         */
+        bool write(const char *data, std::size_t size)
+        {
+            if (file_ && std::fwrite(data, 1, size, file_) == size)
+            {
+                size_ += size;
+                return true;
+            }
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The file (" << path_ << ") could not be written!\n";
+            return false;
+        }
+
+        /**
+         * @brief Close the file, after which it is complete and usable.
+         *
+         * @return False if the file was not open or closing it failed.
+         */
+        bool close()
+        {
+            if (file_)
+            {
+                const auto result = std::fclose(file_);
+                file_ = nullptr;
+                return result == 0;
+            }
+            return false;
+        }
+
+        /**
+         * @brief
+         *
+         * @return
+         */
+        bool is_open() const
+        {
+            return file_ != nullptr;
+        }
+
+        /**
+         * @brief
+         *
+         * @return The path of the file.
+         */
+        const std::string& path() const
+        {
+            return path_;
+        }
+
+        /**
+         * @brief
+         *
+         * @return The amount of bytes written.
+         */
+        std::uint64_t size() const
+        {
+            return size_;
+        }
+
+    private:
+        std::FILE *file_;
+        std::string path_;
+        std::uint64_t size_;
+    };
+
     inline bool read_file(const std::string& file_path, micro_tcp::message& message)
     {
         std::ifstream file(file_path, std::ios::in | std::ios::binary);
@@ -0,0 +1,82 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/handler_memory.hpp>
+#include <new>
+
+namespace micro_tcp
+{
+    namespace
+    {
+        std::atomic<std::uint64_t> arena_allocations{0};
+        std::atomic<std::uint64_t> heap_allocations{0};
+    }
+
+    /*static*/constexpr std::size_t handler_memory::block_count_;
+    /*static*/constexpr std::size_t handler_memory::block_size_;
+
+    handler_memory::handler_memory()
+    {
+        for (auto& in_use : in_use_)
+        {
+            in_use.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void *handler_memory::allocate(std::size_t size)
+    {
+        if (size <= block_size_)
+        {
+            for (std::size_t index = 0; index < block_count_; ++index)
+            {
+                if (!in_use_[index].load(std::memory_order_relaxed) &&
+                    !in_use_[index].exchange(true, std::memory_order_acquire))
+                {
+                    arena_allocations.fetch_add(1, std::memory_order_relaxed);
+                    return blocks_[index].storage_;
+                }
+            }
+        }
+        heap_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    void handler_memory::deallocate(void *pointer)
+    {
+        for (std::size_t index = 0; index < block_count_; ++index)
+        {
+            if (pointer == blocks_[index].storage_)
+            {
+                in_use_[index].store(false, std::memory_order_release);
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+    /*static*/handler_memory::statistics handler_memory::get_statistics()
+    {
+        return {arena_allocations.load(std::memory_order_relaxed), heap_allocations.load(std::memory_order_relaxed)};
+    }
+}
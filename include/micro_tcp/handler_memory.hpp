@@ -0,0 +1,185 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_HANDLER_MEMORY_HPP
+#define MICRO_TCP_HANDLER_MEMORY_HPP
+
+#include <boost/asio/detail/handler_cont_helpers.hpp>
+#include <boost/asio/detail/handler_invoke_helpers.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace micro_tcp
+{
+    /**
+     * @brief A small arena for the operation state Asio allocates for every asynchronous operation and strand
+     * dispatch of a single object (e.g. a session). The blocks are reused from one operation to the next, so a
+     * steady read/write loop does not touch the global heap. Requests larger than a block, or made while every block
+     * is in use, fall back to ::operator new.
+     *
+     * Blocks are claimed with an atomic flag: Asio frees the state of an operation before its handler is run, on
+     * whichever thread completes it, while the next operation may already allocate from within the strand.
+     */
+    class handler_memory
+    {
+    public:
+        /**
+         * @brief Amount of blocks: a read and a write in flight, each with a strand dispatch.
+         */
+        static constexpr std::size_t block_count_ = 4;
+
+        /**
+         * @brief Size of a block, enough for the composed SSL/TLS read and write operations of a session.
+         */
+        static constexpr std::size_t block_size_ = 1024;
+
+        /**
+         * @brief Counters of all arenas.
+         */
+        struct statistics
+        {
+            std::uint64_t arena_allocations_; /*!< Allocations served by a block. */
+            std::uint64_t heap_allocations_; /*!< Allocations that fell back to ::operator new. */
+        };
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        handler_memory(const handler_memory&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        handler_memory& operator=(const handler_memory&) = delete;
+
+        /**
+         * @brief Default constructor.
+         */
+        handler_memory();
+
+        /**
+         * @brief
+         *
+         * @param size The size of the allocation.
+         * @return A free block, or memory from ::operator new if none fits.
+         */
+        void *allocate(std::size_t size);
+
+        /**
+         * @brief
+         *
+         * @param pointer Memory returned by handler_memory::allocate().
+         */
+        void deallocate(void *pointer);
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the counters of all arenas.
+         */
+        static statistics get_statistics();
+
+    private:
+        struct block
+        {
+            alignas(std::max_align_t) unsigned char storage_[block_size_];
+        };
+
+        std::array<block, block_count_> blocks_;
+        std::array<std::atomic<bool>, block_count_> in_use_;
+    };
+
+    /**
+     * @brief Completion handler allocating its operation state from a handler_memory. The other hooks are those of
+     * the inner handler. Wrap it in a strand (e.g. optional_strand::wrap()) rather than the other way around, so
+     * the strand dispatches allocate from the arena as well.
+     */
+    template<typename Handler>
+    class allocating_handler
+    {
+    public:
+        allocating_handler(micro_tcp::handler_memory& memory, Handler handler) :
+                memory_(memory),
+                handler_(std::move(handler))
+        {
+            /*...*/
+        }
+
+        template<typename... Args>
+        void operator()(Args&& ... args)
+        {
+            handler_(std::forward<Args>(args)...);
+        }
+
+        template<typename Function>
+        friend void asio_handler_invoke(Function& function, allocating_handler *this_handler)
+        {
+            boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+        }
+
+        template<typename Function>
+        friend void asio_handler_invoke(const Function& function, allocating_handler *this_handler)
+        {
+            boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+        }
+
+        friend void *asio_handler_allocate(std::size_t size, allocating_handler *this_handler)
+        {
+            return this_handler->memory_.allocate(size);
+        }
+
+        friend void asio_handler_deallocate(void *pointer, std::size_t /*size*/, allocating_handler *this_handler)
+        {
+            this_handler->memory_.deallocate(pointer);
+        }
+
+        friend bool asio_handler_is_continuation(allocating_handler *this_handler)
+        {
+            return boost_asio_handler_cont_helpers::is_continuation(this_handler->handler_);
+        }
+
+    private:
+        micro_tcp::handler_memory& memory_;
+        Handler handler_;
+    };
+
+    /**
+     * @brief
+     *
+     * @param memory The arena, it MUST outlive every operation started with the handler.
+     * @param handler The handler.
+     * @return The handler allocating from [memory].
+     */
+    template<typename Handler>
+    allocating_handler<typename std::decay<Handler>::type> make_allocating_handler(micro_tcp::handler_memory& memory,
+                                                                                    Handler&& handler)
+    {
+        return {memory, std::forward<Handler>(handler)};
+    }
+}
+
+#endif
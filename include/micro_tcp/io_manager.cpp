@@ -23,16 +23,23 @@
 ///
 
 #include <micro_tcp/io_manager.hpp>
+#include <micro_tcp/buffer_pool.hpp>
+#include <micro_tcp/timing_wheel.hpp>
+#include <algorithm>
+#include <iostream>
 
 namespace micro_tcp
 {
-    io_manager::io_manager() :
+    io_manager::io_manager(threading_model model, scheduling_policy policy) :
             active_(false),
-            io_service_(),
-            io_work_informer_(nullptr)
+            threading_model_(model),
+            scheduling_policy_(policy),
+            scheduled_slot_count_(1),
+            next_slot_(0)
     {
-        io_service_.stop();
-        io_service_.reset();
+        add_io_slot();
+        io_slots_.front()->io_service_.stop();
+        io_slots_.front()->io_service_.reset();
     }
 
     io_manager::~io_manager()
@@ -42,7 +49,70 @@ namespace micro_tcp
 
     boost::asio::io_service& io_manager::get_io_service()
     {
-        return io_service_;
+        return io_slots_.front()->io_service_;
+    }
+
+    boost::asio::io_service& io_manager::get_io_service(std::size_t index)
+    {
+        return io_slots_[index]->io_service_;
+    }
+
+    std::size_t io_manager::get_io_service_count() const
+    {
+        return scheduled_slot_count_;
+    }
+
+    io_manager::threading_model io_manager::get_threading_model() const
+    {
+        return threading_model_;
+    }
+
+    io_manager::assignment io_manager::assign_io_service()
+    {
+        std::size_t index = 0;
+        if (scheduling_policy_ == scheduling_policy::least_loaded)
+        {
+            for (std::size_t candidate = 1; candidate < scheduled_slot_count_; ++candidate)
+            {
+                if (io_slots_[candidate]->load_.load(std::memory_order_relaxed) <
+                    io_slots_[index]->load_.load(std::memory_order_relaxed))
+                {
+                    index = candidate;
+                }
+            }
+        }
+        else
+        {
+            index = next_slot_.fetch_add(1, std::memory_order_relaxed) % scheduled_slot_count_;
+        }
+        return assign_io_service(index);
+    }
+
+    io_manager::assignment io_manager::assign_io_service(std::size_t index)
+    {
+        io_slot *slot = io_slots_[index].get();
+        slot->load_.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<void> lease(nullptr, [slot](void *)
+        {
+            slot->load_.fetch_sub(1, std::memory_order_relaxed);
+        });
+        return {&slot->io_service_, std::move(lease), threading_model_ == threading_model::io_service_per_thread};
+    }
+
+    bool io_manager::set_affinity_plan(const micro_tcp::affinity_plan& plan)
+    {
+        if (is_active())
+        {
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The affinity plan can not be changed while running\n";
+            return false;
+        }
+        affinity_plan_ = plan;
+        return true;
+    }
+
+    std::size_t io_manager::get_thread_count() const
+    {
+        return active_ ? io_thread_pool_.size() : 0;
     }
 
     bool io_manager::is_active() const
@@ -54,13 +124,35 @@ namespace micro_tcp
     {
         if (!is_active())
         {
+            if (threading_model_ == threading_model::io_service_per_thread)
+            {
+                while (io_slots_.size() < num_threads)
+                {
+                    add_io_slot();
+                }
+                scheduled_slot_count_ = std::max(num_threads, 1u);
+            }
             io_thread_pool_.clear();
-            io_work_informer_ = std::make_unique<boost::asio::io_service::work>(io_service_);
+            for (auto& slot : io_slots_)
+            {
+                slot->io_work_informer_ = std::make_unique<boost::asio::io_service::work>(slot->io_service_);
+            }
+            const auto cpus = affinity_plan_.resolve();
             io_thread_pool_.reserve(num_threads);
             for (unsigned int worker = 0; worker < num_threads; ++worker)
             {
-                io_thread_pool_.emplace_back([this]()
-                                             { io_service_.run(); });
+                auto& io_service = io_slots_[worker % io_slots_.size()]->io_service_;
+                const auto pinned = !cpus.empty();
+                const auto cpu = pinned ? cpus[worker % cpus.size()] : 0;
+                io_thread_pool_.emplace_back([&io_service, pinned, cpu]()
+                {
+                    // Pin before the first allocation, so the thread cache and its blocks are local to the node.
+                    if (pinned && affinity_plan::pin_current_thread(cpu))
+                    {
+                        buffer_pool::set_numa_node(affinity_plan::numa_node(cpu));
+                    }
+                    io_service.run();
+                });
             }
             active_ = true;
         }
@@ -70,14 +162,30 @@ namespace micro_tcp
     {
         if (is_active())
         {
-            io_work_informer_.reset();
-            io_service_.stop();
+            for (auto& slot : io_slots_)
+            {
+                slot->io_work_informer_.reset();
+                slot->io_service_.stop();
+            }
             for (auto& worker_thread : io_thread_pool_)
             {
                 worker_thread.join();
             }
-            io_service_.reset();
+            for (auto& slot : io_slots_)
+            {
+                slot->io_service_.reset();
+            }
             active_ = false;
         }
     }
-}
\ No newline at end of file
+
+    void io_manager::add_io_slot()
+    {
+        io_slots_.push_back(std::make_unique<io_slot>());
+        if (threading_model_ == threading_model::io_service_per_thread)
+        {
+            auto& io_service = io_slots_.back()->io_service_;
+            boost::asio::add_service(io_service, new micro_tcp::timing_wheel(io_service, 1));
+        }
+    }
+}
@@ -25,7 +25,10 @@
 #ifndef MICRO_TCP_IO_MANAGER_HPP
 #define MICRO_TCP_IO_MANAGER_HPP
 
+#include <micro_tcp/affinity.hpp>
 #include <boost/asio/io_service.hpp>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -34,10 +37,42 @@ namespace micro_tcp
     /**
      * @brief The io_manager holds a io_service instance and the manages it. The io_service provides the core
      * I/O functionality for asynchronous I/O objects.
+     *
+     * With io_manager::threading_model::io_service_per_thread every thread runs an io_service of its own. Sessions
+     * are spread over these io_services with io_manager::assign_io_service() and live on a single thread, so they
+     * do not contend with other sessions on a reactor queue and do not need a strand.
      */
     class io_manager
     {
     public:
+        /**
+         * @brief How the io_services are run by the threads of the io_manager.
+         */
+        enum class threading_model
+        {
+            shared_io_service, /*!< All threads run a single io_service. */
+            io_service_per_thread /*!< Every thread runs an io_service of its own. */
+        };
+
+        /**
+         * @brief How io_manager::assign_io_service() picks an io_service for a new session.
+         */
+        enum class scheduling_policy
+        {
+            round_robin, /*!< Cycle through the io_services. */
+            least_loaded /*!< Pick the io_service with the least assigned sessions. */
+        };
+
+        /**
+         * @brief An io_service picked by io_manager::assign_io_service().
+         */
+        struct assignment
+        {
+            boost::asio::io_service *io_service_; /*!< The io_service to create the session on. */
+            std::shared_ptr<void> lease_; /*!< Counts towards the load of the io_service as long as it is held. */
+            bool single_threaded_; /*!< True if the io_service is run by a single thread. */
+        };
+
         /**
          * @brief Non-copyable - delete copy constructor.
          */
@@ -50,8 +85,12 @@ namespace micro_tcp
 
         /**
          * @brief Default constructor.
+         *
+         * @param model How the io_services are run by the threads.
+         * @param policy How io_services are assigned to new sessions.
          */
-        io_manager();
+        explicit io_manager(threading_model model = threading_model::shared_io_service,
+                            scheduling_policy policy = scheduling_policy::round_robin);
 
         /**
          * @brief Default destructor. Stop the io_service/manager (if still active).
@@ -59,12 +98,70 @@ namespace micro_tcp
         ~io_manager();
 
         /**
-         * @brief Get a reference to the io_manager::io_service_ class member managed by this instance.
+         * @brief Get a reference to the primary io_service managed by this instance. It is run by the first thread
+         * and is meant for acceptors, clients and other objects that are not assigned an io_service.
          *
-         * @return A reference to the io_service_ class instance.
+         * @return A reference to the primary io_service.
          */
         boost::asio::io_service& get_io_service();
 
+        /**
+         * @brief Get a reference to one of the io_services sessions are assigned to.
+         *
+         * @param index The index of the io_service, less than io_manager::get_io_service_count().
+         * @return A reference to the io_service.
+         */
+        boost::asio::io_service& get_io_service(std::size_t index);
+
+        /**
+         * @brief
+         *
+         * @return The amount of io_services sessions are assigned to, one per thread for
+         * io_manager::threading_model::io_service_per_thread once started.
+         */
+        std::size_t get_io_service_count() const;
+
+        /**
+         * @brief
+         *
+         * @return The threading model.
+         */
+        threading_model get_threading_model() const;
+
+        /**
+         * @brief Pick an io_service for a new session according to the scheduling policy. With a shared io_service
+         * this is always the primary io_service.
+         *
+         * @return The io_service, a lease to hold for the lifetime of the session and whether the io_service is run
+         * by a single thread.
+         */
+        assignment assign_io_service();
+
+        /**
+         * @brief Assign a given io_service to a new session, e.g. the io_service of the acceptor that accepted it.
+         *
+         * @param index The index of the io_service, less than io_manager::get_io_service_count().
+         * @return The io_service, a lease to hold for the lifetime of the session and whether the io_service is run
+         * by a single thread.
+         */
+        assignment assign_io_service(std::size_t index);
+
+        /**
+         * @brief Pin the threads to CPUs at the next io_manager::start(). Each pinned thread allocates its buffers
+         * from the pool shard of the NUMA node of its CPU.
+         *
+         * @param plan The affinity plan.
+         * @return False if the io_manager is active.
+         */
+        bool set_affinity_plan(const micro_tcp::affinity_plan& plan);
+
+        /**
+         * @brief
+         *
+         * @return The amount of threads running the io_services, zero if not started.
+         */
+        std::size_t get_thread_count() const;
+
         /**
          * @brief
          * @return
@@ -80,6 +177,10 @@ namespace micro_tcp
          * The io_service is encapsulated within a work informer to ensure it always has at least one job and
          * won't stop/return until io_manager::stop() is manually called.
          *
+         * With io_manager::threading_model::io_service_per_thread an io_service is created for every thread that
+         * does not have one yet. io_services are never destroyed before the io_manager, so sessions can outlive a
+         * stop.
+         *
          * @param num_threads The number of threads the io_service will do work on.
          */
         void start(unsigned int num_threads = std::max(std::thread::hardware_concurrency(), 2u) - 1u);
@@ -97,9 +198,29 @@ namespace micro_tcp
         void stop();
 
     private:
+        /**
+         * @brief An io_service with its work informer and the amount of sessions assigned to it.
+         */
+        struct io_slot
+        {
+            boost::asio::io_service io_service_;
+            std::unique_ptr<boost::asio::io_service::work> io_work_informer_;
+            std::atomic<std::size_t> load_{0};
+        };
+
+        /**
+         * @brief Append an io_slot. In the io_service-per-thread model its io_service gets a single timing_wheel,
+         * since only one thread arms and cancels its timers.
+         */
+        void add_io_slot();
+
         bool active_;
-        boost::asio::io_service io_service_;
-        std::unique_ptr<boost::asio::io_service::work> io_work_informer_;
+        threading_model threading_model_;
+        scheduling_policy scheduling_policy_;
+        micro_tcp::affinity_plan affinity_plan_;
+        std::vector<std::unique_ptr<io_slot>> io_slots_; /*!< The primary io_service comes first. */
+        std::size_t scheduled_slot_count_; /*!< Leading io_slots_ that are run by a thread and assigned sessions. */
+        std::atomic<std::size_t> next_slot_; /*!< Next slot for scheduling_policy::round_robin. */
         std::vector<std::thread> io_thread_pool_;
     };
 }
@@ -0,0 +1,52 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_LOCAL_ENDPOINT_HPP
+#define MICRO_TCP_LOCAL_ENDPOINT_HPP
+
+#include <boost/asio/local/stream_protocol.hpp>
+#include <string>
+
+namespace micro_tcp
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    /**
+     * @brief Endpoint of a Unix domain stream socket, for clients and servers on the same host.
+     *
+     * @param path A filesystem path, or a name starting with '@' for a socket in the abstract namespace (Linux only),
+     * which has no file and disappears with the last socket bound to it.
+     * @return The endpoint.
+     */
+    inline boost::asio::local::stream_protocol::endpoint make_local_endpoint(const std::string& path)
+    {
+        if (!path.empty() && path.front() == '@')
+        {
+            return boost::asio::local::stream_protocol::endpoint(std::string(1, '\0') + path.substr(1));
+        }
+        return boost::asio::local::stream_protocol::endpoint(path);
+    }
+#endif
+}
+
+#endif
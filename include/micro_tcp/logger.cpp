@@ -0,0 +1,324 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/logger.hpp>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace micro_tcp
+{
+    namespace
+    {
+        struct record
+        {
+            std::int64_t time_; /*!< Nanoseconds since the epoch of the system clock. */
+            std::uint32_t thread_;
+            log_level level_;
+            std::uint16_t message_size_;
+            std::uint16_t detail_size_;
+            char text_[logger::max_text_size_]; /*!< Message followed by the detail, not null terminated. */
+        };
+
+        /**
+         * @brief Single producer (the owning thread), single consumer (whoever holds logger_state::drain_mutex_) ring
+         * of records. Head and tail are kept on cache lines of their own.
+         */
+        struct ring
+        {
+            explicit ring(std::uint32_t thread) :
+                    head_(0),
+                    tail_(0),
+                    retired_(false),
+                    thread_(thread)
+            {
+                /*...*/
+            }
+
+            std::atomic<std::size_t> head_;
+            char head_padding_[64 - sizeof(std::atomic<std::size_t>)];
+            std::atomic<std::size_t> tail_;
+            char tail_padding_[64 - sizeof(std::atomic<std::size_t>)];
+            std::atomic<bool> retired_; /*!< Set when the owning thread exits, the ring is removed once drained. */
+            const std::uint32_t thread_;
+            std::array<record, logger::ring_capacity_> records_;
+        };
+
+        struct logger_state
+        {
+            std::mutex rings_mutex_;
+            std::vector<std::unique_ptr<ring>> rings_;
+            std::uint32_t next_thread_ = 0;
+            std::mutex drain_mutex_; /*!< Held by the single consumer of the rings. */
+            std::vector<record> batch_;
+            std::string out_;
+            std::string err_;
+            std::int64_t formatted_second_ = -1;
+            char formatted_time_[32] = {};
+            std::mutex wake_mutex_;
+            std::condition_variable wake_;
+            std::atomic<std::uint64_t> written_{0};
+            std::atomic<std::uint64_t> dropped_{0};
+        };
+
+        const char *level_name(log_level level)
+        {
+            static const char *names[] = {"TRACE", "DEBUG", "INFO", "WARNING", "ERROR", "OFF"};
+            return names[static_cast<std::size_t>(level)];
+        }
+
+        /**
+         * @brief Append the local time of [time] as "%Y-%m-%d %H:%M:%S.%f", the date and time are formatted once per
+         * second.
+         */
+        void format_time(logger_state& state, std::int64_t time, std::string& out)
+        {
+            /* Floored, so times before 1970 keep a fraction in [0, 1) second. */
+            const auto nanoseconds = ((time % 1000000000) + 1000000000) % 1000000000;
+            const auto second = (time - nanoseconds) / 1000000000;
+            if (second != state.formatted_second_)
+            {
+                const auto seconds = static_cast<std::time_t>(second);
+                std::tm local{};
+#ifdef _WIN32
+                localtime_s(&local, &seconds);
+#else
+                localtime_r(&seconds, &local);
+#endif
+                std::strftime(state.formatted_time_, sizeof(state.formatted_time_), "%Y-%m-%d %H:%M:%S", &local);
+                state.formatted_second_ = second;
+            }
+            char microseconds[12];
+            std::snprintf(microseconds, sizeof(microseconds), ".%06u", static_cast<unsigned int>(nanoseconds / 1000));
+            out.append(state.formatted_time_).append(microseconds);
+        }
+
+        void format(logger_state& state, const record& entry)
+        {
+            auto& out = entry.level_ >= log_level::warning ? state.err_ : state.out_;
+            format_time(state, entry.time_, out);
+            out.append(" | ").append(level_name(entry.level_))
+               .append(" | [thread ").append(std::to_string(entry.thread_)).append("] | ")
+               .append(entry.text_, entry.message_size_);
+            if (entry.detail_size_ != 0)
+            {
+                out.append(" | Error code: ").append(entry.text_ + entry.message_size_, entry.detail_size_);
+            }
+            out.push_back('\n');
+        }
+
+        /**
+         * @brief Move the records of all rings to the output, in order of time within this batch.
+         */
+        void drain(logger_state& state)
+        {
+            std::lock_guard<std::mutex> lock(state.drain_mutex_);
+            {
+                std::lock_guard<std::mutex> rings_lock(state.rings_mutex_);
+                for (auto it = state.rings_.begin(); it != state.rings_.end();)
+                {
+                    auto& source = **it;
+                    const auto retired = source.retired_.load(std::memory_order_acquire);
+                    const auto head = source.head_.load(std::memory_order_acquire);
+                    for (auto tail = source.tail_.load(std::memory_order_relaxed); tail != head; ++tail)
+                    {
+                        state.batch_.push_back(source.records_[tail % logger::ring_capacity_]);
+                    }
+                    source.tail_.store(head, std::memory_order_release);
+                    it = retired ? state.rings_.erase(it) : it + 1;
+                }
+            }
+            if (state.batch_.empty())
+            {
+                return;
+            }
+            std::stable_sort(state.batch_.begin(), state.batch_.end(), [](const record& lhs, const record& rhs)
+            {
+                return lhs.time_ < rhs.time_;
+            });
+            for (const auto& entry : state.batch_)
+            {
+                format(state, entry);
+            }
+            if (!state.out_.empty())
+            {
+                std::cout.write(state.out_.data(), static_cast<std::streamsize>(state.out_.size())).flush();
+                state.out_.clear();
+            }
+            if (!state.err_.empty())
+            {
+                std::cerr.write(state.err_.data(), static_cast<std::streamsize>(state.err_.size())).flush();
+                state.err_.clear();
+            }
+            state.written_.fetch_add(state.batch_.size(), std::memory_order_relaxed);
+            state.batch_.clear();
+        }
+
+        void run_flusher(logger_state& state)
+        {
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(state.wake_mutex_);
+                    state.wake_.wait_for(lock, logger::flush_interval_);
+                }
+                drain(state);
+            }
+        }
+
+        /**
+         * @brief The state is never destroyed, objects with static storage duration may log while they are
+         * destroyed. The background thread is started with the state.
+         */
+        std::atomic<bool> started_{false};
+
+        logger_state& global()
+        {
+            static auto *state = []
+            {
+                auto *created = new logger_state();
+                std::thread(run_flusher, std::ref(*created)).detach();
+                started_.store(true, std::memory_order_release);
+                return created;
+            }();
+            return *state;
+        }
+
+        /**
+         * @brief Write the records that are still queued when the program exits.
+         */
+        struct exit_flush
+        {
+            ~exit_flush()
+            {
+                if (started_.load(std::memory_order_acquire))
+                {
+                    logger::flush();
+                }
+            }
+        } exit_flush_;
+
+        struct local_ring
+        {
+            ~local_ring()
+            {
+                if (ring_ != nullptr)
+                {
+                    ring_->retired_.store(true, std::memory_order_release);
+                }
+            }
+
+            ring *ring_ = nullptr;
+        };
+
+        ring& local()
+        {
+            thread_local local_ring local;
+            if (local.ring_ == nullptr)
+            {
+                auto& state = global();
+                std::lock_guard<std::mutex> lock(state.rings_mutex_);
+                state.rings_.push_back(std::unique_ptr<ring>(new ring(state.next_thread_++)));
+                local.ring_ = state.rings_.back().get();
+            }
+            return *local.ring_;
+        }
+    }
+
+    /*static*/constexpr std::size_t logger::ring_capacity_;
+    /*static*/constexpr std::size_t logger::max_text_size_;
+    /*static*/constexpr std::chrono::milliseconds logger::flush_interval_;
+    /*static*/std::atomic<log_level> logger::level_{log_level::info};
+
+    /*static*/void logger::set_level(log_level level)
+    {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    /*static*/log_level logger::get_level()
+    {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    /*static*/bool logger::parse_level(const std::string& name, log_level& level)
+    {
+        static const char *names[] = {"trace", "debug", "info", "warning", "error", "off"};
+        for (std::size_t index = 0; index < sizeof(names) / sizeof(names[0]); ++index)
+        {
+            if (name == names[index])
+            {
+                level = static_cast<log_level>(index);
+                return true;
+            }
+        }
+        std::cerr << __PRETTY_FUNCTION__ << " | " << "Unknown log level: " << name << std::endl;
+        return false;
+    }
+
+    /*static*/void logger::write(log_level level, log_text message, log_text detail)
+    {
+        auto& target = local();
+        const auto head = target.head_.load(std::memory_order_relaxed);
+        if (head - target.tail_.load(std::memory_order_acquire) == ring_capacity_)
+        {
+            global().dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto& entry = target.records_[head % ring_capacity_];
+        entry.time_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        entry.thread_ = target.thread_;
+        entry.level_ = level;
+        const auto message_size = std::min(message.size_, max_text_size_);
+        const auto detail_size = std::min(detail.size_, max_text_size_ - message_size);
+        std::memcpy(entry.text_, message.data_, message_size);
+        std::memcpy(entry.text_ + message_size, detail.data_, detail_size);
+        entry.message_size_ = static_cast<std::uint16_t>(message_size);
+        entry.detail_size_ = static_cast<std::uint16_t>(detail_size);
+        target.head_.store(head + 1, std::memory_order_release);
+        if (level >= log_level::warning)
+        {
+            global().wake_.notify_one();
+        }
+    }
+
+    /*static*/void logger::flush()
+    {
+        drain(global());
+    }
+
+    /*static*/logger::statistics logger::get_statistics()
+    {
+        auto& state = global();
+        return {state.written_.load(std::memory_order_relaxed), state.dropped_.load(std::memory_order_relaxed)};
+    }
+}
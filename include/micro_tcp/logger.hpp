@@ -0,0 +1,209 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_LOGGER_HPP
+#define MICRO_TCP_LOGGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * Lowest log level compiled in, as the value of micro_tcp::log_level (0 trace ... 5 off). Log statements below it are
+ * removed by the compiler, see MICRO_TCP_LOG.
+ */
+#ifndef MICRO_TCP_LOG_MIN_LEVEL
+#define MICRO_TCP_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * Log a message, with an optional detail (e.g. an error code), if [level] is compiled in and enabled at runtime. The
+ * arguments are not evaluated otherwise, so a disabled statement costs a single relaxed load.
+ */
+#define MICRO_TCP_LOG(level, ...) \
+    do \
+    { \
+        if (static_cast<int>(level) >= MICRO_TCP_LOG_MIN_LEVEL && micro_tcp::logger::is_enabled(level)) \
+        { \
+            micro_tcp::logger::write(level, __VA_ARGS__); \
+        } \
+    } while (false)
+
+#define MICRO_TCP_LOG_TRACE(...) MICRO_TCP_LOG(micro_tcp::log_level::trace, __VA_ARGS__)
+#define MICRO_TCP_LOG_DEBUG(...) MICRO_TCP_LOG(micro_tcp::log_level::debug, __VA_ARGS__)
+#define MICRO_TCP_LOG_INFO(...) MICRO_TCP_LOG(micro_tcp::log_level::info, __VA_ARGS__)
+#define MICRO_TCP_LOG_WARNING(...) MICRO_TCP_LOG(micro_tcp::log_level::warning, __VA_ARGS__)
+#define MICRO_TCP_LOG_ERROR(...) MICRO_TCP_LOG(micro_tcp::log_level::error, __VA_ARGS__)
+
+namespace micro_tcp
+{
+    /**
+     * @brief Severity of a log message. log_level::off disables logging.
+     */
+    enum class log_level : int
+    {
+        trace,
+        debug,
+        info,
+        warning,
+        error,
+        off
+    };
+
+    /**
+     * @brief Reference to the text of a log message, a null terminated string or a std::string that outlives the
+     * call to logger::write(). The text is copied by logger::write().
+     */
+    struct log_text
+    {
+        log_text() :
+                data_(""),
+                size_(0)
+        {
+            /*...*/
+        }
+
+        log_text(const char *text) :
+                data_(text),
+                size_(std::strlen(text))
+        {
+            /*...*/
+        }
+
+        log_text(const std::string& text) :
+                data_(text.data()),
+                size_(text.size())
+        {
+            /*...*/
+        }
+
+        const char *data_;
+        std::size_t size_;
+    };
+
+    /**
+     * @brief Process wide asynchronous logger.
+     *
+     * Every thread that logs gets a lock-free ring of fixed size records of its own. logger::write() only copies the
+     * timestamp and text into the next record, a background thread collects the records of all rings every
+     * logger::flush_interval_, orders them by time, formats them and writes them to std::cout (std::cerr for warnings
+     * and errors) in a single batch. Records that do not fit a full ring are dropped and counted. Messages of
+     * level warning and above wake the background thread right away.
+     *
+     * Ordering is best effort within a flush interval: records are only sorted within a batch, so a record published
+     * just after a drain may follow newer records of other threads written by that drain.
+     */
+    class logger
+    {
+    public:
+        /**
+         * @brief Counters of the logger.
+         */
+        struct statistics
+        {
+            std::uint64_t written_; /*!< Records written to the output. */
+            std::uint64_t dropped_; /*!< Records dropped because the ring of the logging thread was full. */
+        };
+
+        /**
+         * @brief Amount of records in the ring of a thread.
+         */
+        static constexpr std::size_t ring_capacity_ = 1024;
+        /**
+         * @brief Maximum size of the message and detail of a record together, longer texts are truncated.
+         */
+        static constexpr std::size_t max_text_size_ = 232;
+        /**
+         * @brief Interval at which the background thread writes the records of all rings.
+         */
+        static constexpr std::chrono::milliseconds flush_interval_{10};
+
+        logger() = delete;
+
+        /**
+         * @brief
+         *
+         * @param level The level of a message.
+         * @return True if messages of [level] are enabled at runtime.
+         */
+        static bool is_enabled(log_level level)
+        {
+            return level >= level_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Set the lowest level that is logged, log_level::info by default. Levels below
+         * MICRO_TCP_LOG_MIN_LEVEL are never logged.
+         *
+         * @param level The level.
+         */
+        static void set_level(log_level level);
+
+        /**
+         * @brief
+         *
+         * @return The lowest level that is logged.
+         */
+        static log_level get_level();
+
+        /**
+         * @brief Parse a level name: trace, debug, info, warning, error or off.
+         *
+         * @param name The name of the level.
+         * @param level Set to the parsed level.
+         * @return True on success, false if [name] is not a level.
+         */
+        static bool parse_level(const std::string& name, log_level& level);
+
+        /**
+         * @brief Queue a message on the ring of the calling thread. Use the MICRO_TCP_LOG macros instead, they skip
+         * the call, and the evaluation of the arguments, for disabled levels.
+         *
+         * @param level The level of the message.
+         * @param message The message.
+         * @param detail Optional detail written after the message, e.g. an error code.
+         */
+        static void write(log_level level, log_text message, log_text detail = log_text());
+
+        /**
+         * @brief Write the queued records of all threads now and wait until they are written.
+         */
+        static void flush();
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the logger counters.
+         */
+        static statistics get_statistics();
+
+    private:
+        static std::atomic<log_level> level_;
+    };
+}
+
+#endif
@@ -0,0 +1,90 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/mapped_file.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <iostream>
+
+namespace micro_tcp
+{
+    /*static*/constexpr std::size_t mapped_file::window_size_;
+
+    mapped_file::mapped_file(const std::string& file_path, std::uint64_t size) :
+            path_(file_path),
+            size_(size),
+            mapping_(file_path.c_str(), boost::interprocess::read_only)
+    {
+        /*...*/
+    }
+
+    /*static*/std::shared_ptr<const mapped_file> mapped_file::open(const std::string& file_path)
+    {
+        boost::system::error_code ec;
+        const auto size = boost::filesystem::file_size(file_path, ec);
+        if (!ec)
+        {
+            try
+            {
+                return std::shared_ptr<const mapped_file>(new mapped_file(file_path, size));
+            }
+            catch (const boost::interprocess::interprocess_exception& e)
+            {
+                std::cerr << __PRETTY_FUNCTION__ << " | " << "The file (" << file_path << ") could not be mapped: "
+                          << e.what() << '\n';
+                return nullptr;
+            }
+        }
+        std::cerr << __PRETTY_FUNCTION__ << " | " << "The file (" << file_path << ") could not be read: "
+                  << ec.message() << '\n';
+        return nullptr;
+    }
+
+    std::unique_ptr<mapped_file::window_type> mapped_file::map_window(std::uint64_t offset, std::size_t length) const
+    {
+        try
+        {
+            auto window = std::make_unique<window_type>(mapping_, boost::interprocess::read_only,
+                                                        static_cast<boost::interprocess::offset_t>(offset), length);
+            window->advise(window_type::advice_sequential);
+            return window;
+        }
+        catch (const boost::interprocess::interprocess_exception& e)
+        {
+            std::cerr << __PRETTY_FUNCTION__ << " | " << "The file (" << path_ << ") could not be mapped at offset "
+                      << offset << ": " << e.what() << '\n';
+            return nullptr;
+        }
+    }
+
+    std::uint64_t mapped_file::size() const
+    {
+        return size_;
+    }
+
+    const std::string& mapped_file::path() const
+    {
+        return path_;
+    }
+}
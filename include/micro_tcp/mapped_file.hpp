@@ -0,0 +1,102 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_MAPPED_FILE_HPP
+#define MICRO_TCP_MAPPED_FILE_HPP
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace micro_tcp
+{
+    /**
+     * @brief A read-only file that is sent as message content straight from a memory mapping. Only a bounded window
+     * of the file is mapped at any time, so the resident memory of a transfer does not grow with the file size.
+     *
+     * @see message::set_content_file(std::shared_ptr<const micro_tcp::mapped_file>)
+     */
+    class mapped_file
+    {
+    public:
+        typedef boost::interprocess::mapped_region window_type;
+
+        /**
+         * @brief Maximum amount of bytes mapped (and written to the stream) at once.
+         */
+        static constexpr std::size_t window_size_ = 4 * 1024 * 1024;
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        mapped_file(const mapped_file&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        /**
+         * @brief Open a file for mapping.
+         *
+         * @param file_path Path to the file.
+         * @return The opened file or nullptr if the file could not be opened.
+         */
+        static std::shared_ptr<const mapped_file> open(const std::string& file_path);
+
+        /**
+         * @brief Map a window of the file, advised for sequential access.
+         *
+         * @param offset Offset of the window in the file.
+         * @param length Length of the window, at most mapped_file::window_size_ is advised.
+         * @return The mapped window or nullptr if mapping failed.
+         */
+        std::unique_ptr<window_type> map_window(std::uint64_t offset, std::size_t length) const;
+
+        /**
+         * @brief
+         *
+         * @return The file size in bytes.
+         */
+        std::uint64_t size() const;
+
+        /**
+         * @brief
+         *
+         * @return The path of the file.
+         */
+        const std::string& path() const;
+
+    private:
+        mapped_file(const std::string& file_path, std::uint64_t size);
+
+        std::string path_;
+        std::uint64_t size_;
+        boost::interprocess::file_mapping mapping_;
+    };
+}
+
+#endif
@@ -23,45 +23,142 @@
 ///
 
 #include <micro_tcp/message.hpp>
-#include <sstream>
-#include <iomanip>
-#include <iterator>
+#include <micro_tcp/mapped_file.hpp>
+#include <boost/endian/conversion.hpp>
 #include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace micro_tcp
 {
+    namespace
+    {
+        constexpr std::size_t version_offset_v2 = 4;
+        constexpr std::size_t flags_offset_v2 = 5;
+        constexpr std::size_t accepted_codecs_offset_v2 = 6;
+        constexpr std::size_t content_length_offset_v2 = 8;
+        constexpr std::size_t request_id_offset_v2 = 16;
+
+        /**
+         * @brief Parse the right-aligned, space padded decimal content length of a v1 header without going through
+         * any stream or locale machinery.
+         */
+        bool decode_content_length_v1(const message::buffer_type& header, std::size_t& content_length)
+        {
+            auto it = header.begin() + message::magic_numbers_.size();
+            while (it != header.end() && *it == ' ')
+            {
+                ++it;
+            }
+            if (it == header.end())
+            {
+                return false;
+            }
+            std::size_t value = 0;
+            for (; it != header.end(); ++it)
+            {
+                if (*it < '0' || *it > '9')
+                {
+                    return false;
+                }
+                value = value * 10 + static_cast<std::size_t>(*it - '0');
+            }
+            content_length = value;
+            return true;
+        }
+
+        bool decode_content_length_v2(const message::buffer_type& header, std::size_t& content_length)
+        {
+            std::uint64_t value;
+            std::memcpy(&value, header.data() + content_length_offset_v2, sizeof(value));
+            value = boost::endian::little_to_native(value);
+            if (value > std::numeric_limits<std::size_t>::max())
+            {
+                return false;
+            }
+            content_length = static_cast<std::size_t>(value);
+            return true;
+        }
+    }
+
     /*static*/constexpr std::array<message::buffer_type::value_type, 18> message::magic_numbers_;
+    /*static*/constexpr std::array<message::buffer_type::value_type, 4> message::magic_numbers_v2_;
+    /*static*/constexpr std::uint64_t message::max_content_length_v1_;
+    /*static*/constexpr std::size_t message::header_length_v2_;
+    /*static*/constexpr std::size_t message::protocol_detection_length_;
+    /*static*/constexpr protocol_version message::default_protocol_version_;
+    /*static*/constexpr std::size_t message::max_retained_capacity_;
+    /*static*/constexpr std::uint64_t message::default_max_content_length_;
 
-    message::message()
+    message::message() :
+            version_(default_protocol_version_),
+            flags_(0),
+            accepted_codecs_(0),
+            request_id_(0)
     {
         prepare_header_buffer_read();
     }
 
-    message::message(const std::string& content)
+    message::message(const std::string& content) :
+            version_(default_protocol_version_),
+            flags_(0),
+            accepted_codecs_(0),
+            request_id_(0)
     {
         set_content_buffer(content);
     }
 
-    message::message(const buffer_type& content)
+    message::message(const buffer_type& content) :
+            version_(default_protocol_version_),
+            flags_(0),
+            accepted_codecs_(0),
+            request_id_(0)
     {
         set_content_buffer(content);
     }
 
     message::~message() = default;
 
-    void message::prepare_header_buffer_write()
+    bool message::prepare_header_buffer_write()
     {
-        header_buffer_.assign(magic_numbers_.begin(), magic_numbers_.end());
-        std::stringstream content_length_buffer;
-        content_length_buffer << std::noskipws << std::setw(content_length_digits10_) << content_buffer_.size();
-        std::copy(std::istream_iterator<buffer_type::value_type>(content_length_buffer),
-                  std::istream_iterator<buffer_type::value_type>(),
-                  std::back_inserter(header_buffer_));
+        if (get_content_length() > max_content_length(version_))
+        {
+            clear_header_buffer();
+            return false;
+        }
+        header_buffer_.resize(header_length(version_));
+        auto *header = header_buffer_.data();
+        if (version_ == protocol_version::v1)
+        {
+            std::memcpy(header, magic_numbers_.data(), magic_numbers_.size());
+            auto *digit = header + header_buffer_.size();
+            auto *digits_begin = header + magic_numbers_.size();
+            std::fill(digits_begin, digit, ' ');
+            auto content_length = get_content_length();
+            do
+            {
+                *--digit = static_cast<buffer_type::value_type>('0' + content_length % 10);
+                content_length /= 10;
+            } while (content_length != 0);
+        }
+        else
+        {
+            std::memcpy(header, magic_numbers_v2_.data(), magic_numbers_v2_.size());
+            header[version_offset_v2] = static_cast<buffer_type::value_type>(version_);
+            header[flags_offset_v2] = static_cast<buffer_type::value_type>(flags_);
+            const auto accepted_codecs = boost::endian::native_to_little(accepted_codecs_);
+            std::memcpy(header + accepted_codecs_offset_v2, &accepted_codecs, sizeof(accepted_codecs));
+            const auto content_length = boost::endian::native_to_little(get_content_length());
+            std::memcpy(header + content_length_offset_v2, &content_length, sizeof(content_length));
+            const auto request_id = boost::endian::native_to_little(request_id_);
+            std::memcpy(header + request_id_offset_v2, &request_id, sizeof(request_id));
+        }
+        return true;
     }
 
     void message::prepare_content_buffer_write()
     {
-        if (content_buffer_.size() != get_header_buffer_content_length())
+        if (get_content_length() != get_header_buffer_content_length())
         {
             prepare_header_buffer_write();
         }
@@ -70,7 +167,7 @@ namespace micro_tcp
     void message::prepare_header_buffer_read()
     {
         clear_header_buffer();
-        header_buffer_.resize(magic_numbers_.size() + content_length_digits10_);
+        header_buffer_.resize(header_length(version_));
     }
 
     void message::prepare_content_buffer_read()
@@ -79,59 +176,145 @@ namespace micro_tcp
         content_buffer_.resize(get_header_buffer_content_length());
     }
 
-    std::size_t message::get_header_buffer_content_length()
+    bool message::is_valid_header(std::uint64_t max_content_length) const
     {
-        if (header_buffer_.size() != message::default_header_length())
+        if (header_buffer_.size() != header_length(version_))
         {
-            return 0;
+            return false;
+        }
+        std::size_t content_length;
+        if (version_ == protocol_version::v1)
+        {
+            return std::equal(magic_numbers_.begin(), magic_numbers_.end(), header_buffer_.begin())
+                   && decode_content_length_v1(header_buffer_, content_length)
+                   && content_length <= max_content_length;
+        }
+        return std::memcmp(header_buffer_.data(), magic_numbers_v2_.data(), magic_numbers_v2_.size()) == 0
+               && header_buffer_[version_offset_v2] == static_cast<buffer_type::value_type>(protocol_version::v2)
+               && decode_content_length_v2(header_buffer_, content_length)
+               && content_length <= max_content_length;
+    }
+
+    void message::decode_header_fields()
+    {
+        flags_ = 0;
+        accepted_codecs_ = 0;
+        request_id_ = 0;
+        if (version_ == protocol_version::v2 && header_buffer_.size() == header_length_v2_)
+        {
+            flags_ = static_cast<std::uint8_t>(header_buffer_[flags_offset_v2]);
+            std::memcpy(&accepted_codecs_, header_buffer_.data() + accepted_codecs_offset_v2, sizeof(accepted_codecs_));
+            accepted_codecs_ = boost::endian::little_to_native(accepted_codecs_);
+            std::memcpy(&request_id_, header_buffer_.data() + request_id_offset_v2, sizeof(request_id_));
+            request_id_ = boost::endian::little_to_native(request_id_);
         }
+    }
 
-        std::stringstream content_length_buffer;
-        content_length_buffer << std::setw(content_length_digits10_);
-        std::copy(header_buffer_.begin() + magic_numbers_.size(),
-                  header_buffer_.end(),
-                  std::ostream_iterator<buffer_type::value_type>(content_length_buffer));
-        if (content_length_buffer.good())
+    std::size_t message::get_header_buffer_content_length() const
+    {
+        if (header_buffer_.size() != header_length(version_))
         {
-            std::size_t content_length;
-            content_length_buffer >> content_length;
-            return content_length;
+            return 0;
         }
-        return 0;
+
+        std::size_t content_length = 0;
+        const auto decoded = (version_ == protocol_version::v1) ? decode_content_length_v1(header_buffer_, content_length)
+                                                                : decode_content_length_v2(header_buffer_, content_length);
+        return decoded ? content_length : 0;
     }
 
     void message::clear()
     {
         clear_header_buffer();
         clear_content_buffer();
+        content_file_.reset();
+        flags_ = 0;
+        accepted_codecs_ = 0;
+        request_id_ = 0;
     }
 
     void message::clear_header_buffer()
     {
         header_buffer_.clear();
-        header_buffer_.shrink_to_fit();
+        if (header_buffer_.capacity() > max_retained_capacity_)
+        {
+            header_buffer_.shrink_to_fit();
+        }
     }
 
     void message::clear_content_buffer()
     {
         content_buffer_.clear();
-        content_buffer_.shrink_to_fit();
+        if (content_buffer_.capacity() > max_retained_capacity_)
+        {
+            content_buffer_.shrink_to_fit();
+        }
     }
 
     void message::set_content_buffer(const std::string& content)
     {
+        content_file_.reset();
         content_buffer_.assign(content.begin(), content.end());
         prepare_header_buffer_write();
     }
 
     void message::set_content_buffer(const buffer_type& content)
     {
+        content_file_.reset();
         content_buffer_ = content;
         prepare_header_buffer_write();
     }
 
+    void message::set_content_file(std::shared_ptr<const micro_tcp::mapped_file> file)
+    {
+        clear_content_buffer();
+        content_file_ = std::move(file);
+        prepare_header_buffer_write();
+    }
+
+    std::uint64_t message::get_content_length() const
+    {
+        return content_file_ ? content_file_->size() : content_buffer_.size();
+    }
+
+    void message::set_protocol_version(protocol_version version)
+    {
+        version_ = version;
+    }
+
+    /*static*/std::uint64_t message::max_content_length(protocol_version version)
+    {
+        return (version == protocol_version::v1) ? max_content_length_v1_ : std::numeric_limits<std::uint64_t>::max();
+    }
+
     /*static*/std::size_t message::default_header_length()
     {
-        return magic_numbers_.size() + content_length_digits10_;
+        return header_length(default_protocol_version_);
+    }
+
+    /*static*/std::size_t message::header_length(protocol_version version)
+    {
+        return (version == protocol_version::v1) ? magic_numbers_.size() + content_length_digits10_ : header_length_v2_;
+    }
+
+    /*static*/bool message::detect_protocol_version(const buffer_type::value_type *data, std::size_t size,
+                                                    protocol_version& version)
+    {
+        static_assert(protocol_detection_length_ <= magic_numbers_v2_.size(), "Detection exceeds the v2 magic numbers");
+        if (size < protocol_detection_length_)
+        {
+            return false;
+        }
+        if (std::memcmp(data, magic_numbers_v2_.data(), protocol_detection_length_) == 0)
+        {
+            version = protocol_version::v2;
+            return true;
+        }
+        if (std::memcmp(data, magic_numbers_.data(), protocol_detection_length_) == 0)
+        {
+            version = protocol_version::v1;
+            return true;
+        }
+        return false;
     }
 }
\ No newline at end of file
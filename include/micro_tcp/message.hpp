@@ -25,26 +25,79 @@
 #ifndef MICRO_TCP_MESSAGE_HPP
 #define MICRO_TCP_MESSAGE_HPP
 
+#include <micro_tcp/buffer_pool.hpp>
 #include <vector>
 #include <array>
+#include <string>
+#include <cstdint>
+#include <memory>
 
 namespace micro_tcp
 {
+    class mapped_file;
+
+    /**
+     * @brief Version of the wire header that precedes every message on the stream.
+     *
+     * @li v1: 28 bytes, the textual magic "/broekman/tcp/1.0/" followed by the content length as 10 right-aligned
+     * decimal digits.
+     * @li v2: 24 bytes, a binary header: magic (4 bytes), version (1 byte), flags (1 byte), accepted compression
+     * codecs (2 bytes, little-endian bit mask), the content length and the request id, both as unsigned 64-bit
+     * little-endian integers. A response carries the
+     * request id of its request, so responses can be sent and matched in any order.
+     */
+    enum class protocol_version : std::uint8_t
+    {
+        v1 = 1,
+        v2 = 2
+    };
+
     /**
      * @brief
      */
     struct message
     {
-        typedef std::vector<char> buffer_type;
+        typedef std::vector<char, micro_tcp::pool_allocator<char>> buffer_type;
 
         /**
-         * @brief
+         * @brief Magic numbers of a v1 header.
          */
         static constexpr std::array<buffer_type::value_type, 18> magic_numbers_ = {'/', 'b', 'r', 'o', 'e', 'k', 'm', 'a', 'n', '/', 't', 'c', 'p', '/', '1', '.', '0', '/'};
         /**
-         * @brief
+         * @brief Number of decimal digits used for the content length of a v1 header.
          */
         static constexpr auto content_length_digits10_ = 10;
+        /**
+         * @brief Largest content length a v1 header can encode (content_length_digits10_ nines). Larger content
+         * can only be sent with a v2 header.
+         */
+        static constexpr std::uint64_t max_content_length_v1_ = 9999999999;
+        /**
+         * @brief Magic numbers of a v2 header.
+         */
+        static constexpr std::array<buffer_type::value_type, 4> magic_numbers_v2_ = {'B', 'T', 'C', 'P'};
+        /**
+         * @brief Length of a v2 header: magic (4), version (1), flags (1), accepted codecs (2), content length (8) and
+         * request id (8).
+         */
+        static constexpr std::size_t header_length_v2_ = 24;
+        /**
+         * @brief Amount of leading header bytes required to detect the protocol version of a header.
+         */
+        static constexpr std::size_t protocol_detection_length_ = 4;
+        /**
+         * @brief The protocol version used by a message unless set otherwise.
+         */
+        static constexpr protocol_version default_protocol_version_ = protocol_version::v2;
+        /**
+         * @brief Buffers keep their capacity when cleared, unless it exceeds this amount of bytes.
+         */
+        static constexpr std::size_t max_retained_capacity_ = buffer_pool::max_block_size_;
+        /**
+         * @brief Largest content length accepted from a peer unless configured otherwise. Incoming content is
+         * buffered in memory, so a header claiming more is rejected before anything is allocated.
+         */
+        static constexpr std::uint64_t default_max_content_length_ = std::uint64_t(1) << 30;
 
         /**
          * @brief
@@ -68,10 +121,28 @@ namespace micro_tcp
          */
         ~message();
 
+        message(const message&) = default;
+
+        message& operator=(const message&) = default;
+
         /**
-         * @brief
+         * @brief Move constructor, buffers are moved without reallocation.
          */
-        void prepare_header_buffer_write();
+        message(message&&) noexcept = default;
+
+        /**
+         * @brief Move assignment operator, buffers are moved without reallocation.
+         */
+        message& operator=(message&&) noexcept = default;
+
+        /**
+         * @brief Encode the header for the current content length in the format of message::version_.
+         *
+         * @return False if the content length does not fit the header of message::version_ (see
+         * message::max_content_length_v1_), the header buffer is then cleared.
+         * @see message::get_content_length()
+         */
+        bool prepare_header_buffer_write();
 
         /**
          * @brief
@@ -79,7 +150,7 @@ namespace micro_tcp
         void prepare_content_buffer_write();
 
         /**
-         * @brief
+         * @brief Clear the header buffer and resize it to the header length of message::version_.
          */
         void prepare_header_buffer_read();
 
@@ -94,21 +165,38 @@ namespace micro_tcp
         void clear();
 
         /**
-         * @brief
+         * @brief Clear the header buffer. The capacity is kept (up to message::max_retained_capacity_) for reuse.
          */
         void clear_header_buffer();
 
         /**
-         * @brief
+         * @brief Clear the content buffer. The capacity is kept (up to message::max_retained_capacity_) for reuse.
          */
         void clear_content_buffer();
 
         /**
-         * @brief
+         * @brief Check whether the header buffer holds a complete header of message::version_ with valid magic
+         * numbers (and version byte or length digits) and a content length of at most max_content_length. Used to
+         * reject corrupt, foreign or oversized frames before any content is read.
          *
-         * @return
+         * @param max_content_length The largest content length accepted.
+         * @return True if the header is valid.
          */
-        std::size_t get_header_buffer_content_length();
+        bool is_valid_header(std::uint64_t max_content_length) const;
+
+        /**
+         * @brief Decode the flags, accepted codecs and request id from the header buffer into message::flags_,
+         * message::accepted_codecs_ and message::request_id_. A v1 header has none of these fields, they are set
+         * to 0.
+         */
+        void decode_header_fields();
+
+        /**
+         * @brief Decode the content length from the header buffer.
+         *
+         * @return The content length or 0 if the header is not a complete header of message::version_.
+         */
+        std::size_t get_header_buffer_content_length() const;
 
         /**
          * @brief
@@ -125,13 +213,67 @@ namespace micro_tcp
         void set_content_buffer(const buffer_type& content);
 
         /**
+         * @brief Use a mapped file as content instead of the content buffer. The file is streamed to the stream
+         * window by window and never copied into the content buffer.
+         *
+         * @param file The file to send, the content buffer is cleared.
+         */
+        void set_content_file(std::shared_ptr<const micro_tcp::mapped_file> file);
+
+        /**
+         * @brief
          *
-         * @return
+         * @return The size of the content file if set, otherwise the size of the content buffer.
+         */
+        std::uint64_t get_content_length() const;
+
+        /**
+         * @brief Set the protocol version used to encode and decode the header of this message.
+         *
+         * @param version The protocol version.
+         */
+        void set_protocol_version(protocol_version version);
+
+        /**
+         * @brief
+         *
+         * @param version
+         * @return The largest content length a header in the given protocol version can encode.
+         */
+        static std::uint64_t max_content_length(protocol_version version);
+
+        /**
+         *
+         * @return The header length of message::default_protocol_version_.
          */
         static std::size_t default_header_length();
 
+        /**
+         * @brief
+         *
+         * @param version
+         * @return The length of a header in the given protocol version.
+         */
+        static std::size_t header_length(protocol_version version);
+
+        /**
+         * @brief Detect the protocol version from the leading bytes of a header by matching the magic numbers.
+         *
+         * @param data Pointer to at least message::protocol_detection_length_ header bytes.
+         * @param size Amount of bytes available at data.
+         * @param version Set to the detected protocol version on success.
+         * @return False if not enough bytes are available or the magic numbers do not match any known version.
+         */
+        static bool detect_protocol_version(const buffer_type::value_type *data, std::size_t size,
+                                            protocol_version& version);
+
         buffer_type header_buffer_; /*!< Buffer used for incoming/outgoing header bytes. */
         buffer_type content_buffer_; /*!< Buffer used for incoming/outgoing content bytes. */
+        protocol_version version_; /*!< Protocol version of the header. */
+        std::uint8_t flags_; /*!< Header flags (v2 only). */
+        std::uint16_t accepted_codecs_; /*!< Compression codecs the sender can decode, see compression_codec (v2 only). */
+        std::uint64_t request_id_; /*!< Id matching a response to its request (v2 only). */
+        std::shared_ptr<const micro_tcp::mapped_file> content_file_; /*!< Outgoing content backed by a file. */
     };
 }
 
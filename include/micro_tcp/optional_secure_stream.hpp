@@ -0,0 +1,202 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_OPTIONAL_SECURE_STREAM_HPP
+#define MICRO_TCP_OPTIONAL_SECURE_STREAM_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/detail/bind_handler.hpp>
+#include <utility>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Transport of the messages of a session.
+     */
+    enum class transport
+    {
+        secure, /*!< SSL/TLS on top of the socket. */
+        plain /*!< The socket without encryption, for trusted links only (e.g. a Unix domain socket, loopback or a
+                   private backend network). */
+    };
+
+    /**
+     * @brief A secure (SSL/TLS) stream that can be switched off. Without SSL/TLS, reads and writes go to the socket
+     * directly and the handshake and shutdown complete right away, so a session runs the same sequence either way.
+     * The interface mirrors the subset of boost::asio::ssl::stream used by the sessions.
+     */
+    class optional_secure_stream
+    {
+    public:
+        typedef boost::asio::generic::stream_protocol::socket next_layer_type;
+        typedef boost::asio::ssl::stream<next_layer_type&> secure_stream_type;
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        optional_secure_stream(const optional_secure_stream&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        optional_secure_stream& operator=(const optional_secure_stream&) = delete;
+
+        /**
+         * @brief Default constructor. SSL/TLS is enabled.
+         *
+         * @param socket The socket, it MUST outlive the stream.
+         * @param context The secure (SSL/TLS) options, certificates, verification mode and so on.
+         */
+        optional_secure_stream(next_layer_type& socket, boost::asio::ssl::context& context) :
+                secure_stream_(socket, context),
+                enabled_(true)
+        {
+            /*...*/
+        }
+
+        /**
+         * @brief Enable or disable SSL/TLS. MUST be called before the handshake.
+         *
+         * @param enabled False to read and write the socket without encryption.
+         */
+        void set_enabled(bool enabled)
+        {
+            enabled_ = enabled;
+        }
+
+        /**
+         * @brief
+         *
+         * @return True if messages are sent over SSL/TLS.
+         */
+        bool is_enabled() const
+        {
+            return enabled_;
+        }
+
+        /**
+         * @brief
+         *
+         * @return A reference to the io_service of the socket.
+         */
+        boost::asio::io_service& get_io_service()
+        {
+            return secure_stream_.get_io_service();
+        }
+
+        /**
+         * @brief
+         *
+         * @return A reference to the socket.
+         */
+        next_layer_type& next_layer()
+        {
+            return secure_stream_.next_layer();
+        }
+
+        /**
+         * @brief
+         *
+         * @return A reference to the SSL/TLS stream, e.g. to reach its native handle.
+         */
+        secure_stream_type& secure_stream()
+        {
+            return secure_stream_;
+        }
+
+        /**
+         * @brief See boost::asio::ssl::stream::async_handshake(). Without SSL/TLS the handler is posted with success.
+         */
+        template<typename HandshakeHandler>
+        void async_handshake(boost::asio::ssl::stream_base::handshake_type type, HandshakeHandler&& handler)
+        {
+            if (enabled_)
+            {
+                secure_stream_.async_handshake(type, std::forward<HandshakeHandler>(handler));
+            }
+            else
+            {
+                get_io_service().post(boost::asio::detail::bind_handler(std::forward<HandshakeHandler>(handler),
+                                                                        boost::system::error_code()));
+            }
+        }
+
+        /**
+         * @brief See boost::asio::ssl::stream::async_shutdown(). Without SSL/TLS the handler is posted with success.
+         */
+        template<typename ShutdownHandler>
+        void async_shutdown(ShutdownHandler&& handler)
+        {
+            if (enabled_)
+            {
+                secure_stream_.async_shutdown(std::forward<ShutdownHandler>(handler));
+            }
+            else
+            {
+                get_io_service().post(boost::asio::detail::bind_handler(std::forward<ShutdownHandler>(handler),
+                                                                        boost::system::error_code()));
+            }
+        }
+
+        /**
+         * @brief See boost::asio::ssl::stream::async_read_some().
+         */
+        template<typename MutableBufferSequence, typename ReadHandler>
+        void async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler)
+        {
+            if (enabled_)
+            {
+                secure_stream_.async_read_some(buffers, std::forward<ReadHandler>(handler));
+            }
+            else
+            {
+                next_layer().async_read_some(buffers, std::forward<ReadHandler>(handler));
+            }
+        }
+
+        /**
+         * @brief See boost::asio::ssl::stream::async_write_some().
+         */
+        template<typename ConstBufferSequence, typename WriteHandler>
+        void async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler)
+        {
+            if (enabled_)
+            {
+                secure_stream_.async_write_some(buffers, std::forward<WriteHandler>(handler));
+            }
+            else
+            {
+                next_layer().async_write_some(buffers, std::forward<WriteHandler>(handler));
+            }
+        }
+
+    private:
+        secure_stream_type secure_stream_;
+        bool enabled_;
+    };
+}
+
+#endif
@@ -0,0 +1,289 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_OPTIONAL_STRAND_HPP
+#define MICRO_TCP_OPTIONAL_STRAND_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/detail/handler_alloc_helpers.hpp>
+#include <boost/asio/detail/handler_cont_helpers.hpp>
+#include <boost/asio/detail/handler_invoke_helpers.hpp>
+#include <type_traits>
+#include <utility>
+
+namespace micro_tcp
+{
+    namespace detail
+    {
+        /**
+         * @brief A function (e.g. the next step of a composed operation) dispatched to a strand on behalf of a
+         * wrapped handler. Its hooks are those of the inner handler, so the dispatch does not end up in the hooks of
+         * the wrapped handler again.
+         */
+        template<typename Function, typename Handler>
+        class rewrapped_handler
+        {
+        public:
+            rewrapped_handler(const Function& function, const Handler& context) :
+                    function_(function),
+                    context_(context)
+            {
+                /*...*/
+            }
+
+            void operator()()
+            {
+                function_();
+            }
+
+            template<typename F>
+            friend void asio_handler_invoke(F& function, rewrapped_handler *this_handler)
+            {
+                boost_asio_handler_invoke_helpers::invoke(function, this_handler->context_);
+            }
+
+            template<typename F>
+            friend void asio_handler_invoke(const F& function, rewrapped_handler *this_handler)
+            {
+                boost_asio_handler_invoke_helpers::invoke(function, this_handler->context_);
+            }
+
+            friend void *asio_handler_allocate(std::size_t size, rewrapped_handler *this_handler)
+            {
+                return boost_asio_handler_alloc_helpers::allocate(size, this_handler->context_);
+            }
+
+            friend void asio_handler_deallocate(void *pointer, std::size_t size, rewrapped_handler *this_handler)
+            {
+                boost_asio_handler_alloc_helpers::deallocate(pointer, size, this_handler->context_);
+            }
+
+            friend bool asio_handler_is_continuation(rewrapped_handler *this_handler)
+            {
+                return boost_asio_handler_cont_helpers::is_continuation(this_handler->context_);
+            }
+
+        private:
+            Function function_;
+            Handler context_;
+        };
+    }
+
+    /**
+     * @brief Completion handler wrapped by an optional_strand. With a strand it behaves like a handler returned by
+     * boost::asio::io_service::strand::wrap(), including the intermediate handlers of composed operations. Without
+     * a strand it is called directly.
+     */
+    template<typename Handler>
+    class optional_strand_handler
+    {
+    public:
+        optional_strand_handler(boost::asio::io_service::strand *strand, Handler handler) :
+                strand_(strand),
+                handler_(std::move(handler))
+        {
+            /*...*/
+        }
+
+        template<typename... Args>
+        void operator()(Args&& ... args)
+        {
+            if (strand_)
+            {
+                strand_->dispatch([handler = std::move(handler_), args...]() mutable
+                                  { handler(args...); });
+            }
+            else
+            {
+                handler_(std::forward<Args>(args)...);
+            }
+        }
+
+        template<typename Function>
+        friend void asio_handler_invoke(Function& function, optional_strand_handler *this_handler)
+        {
+            if (this_handler->strand_)
+            {
+                this_handler->strand_->dispatch(
+                        detail::rewrapped_handler<Function, Handler>(function, this_handler->handler_));
+            }
+            else
+            {
+                boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+            }
+        }
+
+        template<typename Function>
+        friend void asio_handler_invoke(const Function& function, optional_strand_handler *this_handler)
+        {
+            if (this_handler->strand_)
+            {
+                this_handler->strand_->dispatch(
+                        detail::rewrapped_handler<Function, Handler>(function, this_handler->handler_));
+            }
+            else
+            {
+                boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+            }
+        }
+
+        friend void *asio_handler_allocate(std::size_t size, optional_strand_handler *this_handler)
+        {
+            return boost_asio_handler_alloc_helpers::allocate(size, this_handler->handler_);
+        }
+
+        friend void asio_handler_deallocate(void *pointer, std::size_t size, optional_strand_handler *this_handler)
+        {
+            boost_asio_handler_alloc_helpers::deallocate(pointer, size, this_handler->handler_);
+        }
+
+        friend bool asio_handler_is_continuation(optional_strand_handler *this_handler)
+        {
+            return this_handler->strand_ ? this_handler->strand_->running_in_this_thread()
+                                         : boost_asio_handler_cont_helpers::is_continuation(this_handler->handler_);
+        }
+
+    private:
+        boost::asio::io_service::strand *strand_;
+        Handler handler_;
+    };
+
+    /**
+     * @brief A strand that can be switched off. Objects whose handlers all run on an io_service with a single thread
+     * are serialized by that thread already, so the strand (and its locking and queueing) can be skipped. The
+     * interface mirrors the subset of boost::asio::io_service::strand used by the sessions.
+     */
+    class optional_strand
+    {
+    public:
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        optional_strand(const optional_strand&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        optional_strand& operator=(const optional_strand&) = delete;
+
+        /**
+         * @brief Default constructor. The strand is enabled.
+         *
+         * @param io_service The io_service the handlers are run on.
+         */
+        explicit optional_strand(boost::asio::io_service& io_service) :
+                strand_(io_service),
+                enabled_(true)
+        {
+            /*...*/
+        }
+
+        /**
+         * @brief Enable or disable the strand. MUST NOT be called while handlers wrapped by this strand are pending.
+         *
+         * @param enabled False if every handler is run by the one thread running the io_service.
+         */
+        void set_enabled(bool enabled)
+        {
+            enabled_ = enabled;
+        }
+
+        /**
+         * @brief
+         *
+         * @return True if handlers are serialized through the strand.
+         */
+        bool is_enabled() const
+        {
+            return enabled_;
+        }
+
+        /**
+         * @brief
+         *
+         * @return A reference to the io_service the handlers are run on.
+         */
+        boost::asio::io_service& get_io_service()
+        {
+            return strand_.get_io_service();
+        }
+
+        /**
+         * @brief Wrap a completion handler, see boost::asio::io_service::strand::wrap().
+         *
+         * @param handler The handler to wrap.
+         * @return The wrapped handler.
+         */
+        template<typename Handler>
+        optional_strand_handler<typename std::decay<Handler>::type> wrap(Handler&& handler)
+        {
+            return {enabled_ ? &strand_ : nullptr, std::forward<Handler>(handler)};
+        }
+
+        /**
+         * @brief Run a handler now if that is allowed, see boost::asio::io_service::strand::dispatch(). Without a
+         * strand the io_service is only single threaded, so the calling thread is the io_service thread or the
+         * handler is posted.
+         *
+         * @param handler The handler to run.
+         */
+        template<typename Handler>
+        void dispatch(Handler&& handler)
+        {
+            if (enabled_)
+            {
+                strand_.dispatch(std::forward<Handler>(handler));
+            }
+            else
+            {
+                strand_.get_io_service().dispatch(std::forward<Handler>(handler));
+            }
+        }
+
+        /**
+         * @brief Queue a handler, see boost::asio::io_service::strand::post().
+         *
+         * @param handler The handler to queue.
+         */
+        template<typename Handler>
+        void post(Handler&& handler)
+        {
+            if (enabled_)
+            {
+                strand_.post(std::forward<Handler>(handler));
+            }
+            else
+            {
+                strand_.get_io_service().post(std::forward<Handler>(handler));
+            }
+        }
+
+    private:
+        boost::asio::io_service::strand strand_;
+        bool enabled_;
+    };
+}
+
+#endif
@@ -26,6 +26,7 @@
 #define MICRO_TCP_REQUEST_HANDLER_HPP
 
 #include <micro_tcp/message.hpp>
+#include <micro_tcp/responder.hpp>
 
 namespace micro_tcp
 {
@@ -33,6 +34,10 @@ namespace micro_tcp
      * @brief This class should be derived from and its functionality should be overridden where at least
      * request_handler::handle_request(const micro_tcp::message&, broekman::tcp_ip::message&) should be
      * implemented.
+     *
+     * A handler that has to wait for something (a database, another service) overrides
+     * request_handler::is_asynchronous() and request_handler::handle_request_async() instead, and sends the response
+     * through the responder whenever it is ready. The session keeps reading requests in the meantime.
      */
     class request_handler
     {
@@ -51,6 +56,32 @@ namespace micro_tcp
         {
             response.set_content_buffer(request.content_buffer_); //Echo
         }
+
+        /**
+         * @brief Handle a request without producing the response before returning. Called instead of
+         * request_handler::handle_request(const micro_tcp::message&, micro_tcp::message&) if
+         * request_handler::is_asynchronous() returns true.
+         *
+         * @param request The request, only valid during the call: copy what is needed later.
+         * @param responder Send the response through it, from any thread, once it is ready.
+         */
+        inline virtual void handle_request_async(const micro_tcp::message& request, micro_tcp::responder responder)
+        {
+            micro_tcp::message response;
+            handle_request(request, response);
+            responder.send(std::move(response));
+        }
+
+        /**
+         * @brief
+         *
+         * @return True to have requests handled by request_handler::handle_request_async(). Queried once when a
+         * session is created, the result MUST NOT change afterwards.
+         */
+        inline virtual bool is_asynchronous() const
+        {
+            return false;
+        }
     };
 }
 
@@ -0,0 +1,122 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_RESPONDER_HPP
+#define MICRO_TCP_RESPONDER_HPP
+
+#include <micro_tcp/logger.hpp>
+#include <micro_tcp/message.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Completes a request with a response, possibly long after the request handler has returned and from any
+     * thread. Copies refer to the same request, only the first response sent is used. If the last copy is destroyed
+     * without a response, an empty response is sent, so the session never waits forever for a dropped request.
+     *
+     * @see request_handler::handle_request_async(const micro_tcp::message&, micro_tcp::responder)
+     */
+    class responder
+    {
+    public:
+        typedef std::function<void(micro_tcp::message)> completion_type;
+
+        /**
+         * @brief Default constructor. A responder that is not bound to a request.
+         */
+        responder() = default;
+
+        /**
+         * @brief
+         *
+         * @param completion Called once with the response, from the thread that sends it.
+         */
+        explicit responder(completion_type completion) :
+                state_(std::make_shared<state>(std::move(completion)))
+        {
+            /*...*/
+        }
+
+        /**
+         * @brief Send the response. Thread-safe, only the first call has effect. Does nothing if the responder is
+         * not bound to a request.
+         *
+         * @param response The response.
+         * @return False if a response was sent before or the responder is not bound to a request.
+         */
+        bool send(micro_tcp::message response) const
+        {
+            if (!state_)
+            {
+                return false;
+            }
+            if (state_->sent_.exchange(true))
+            {
+                MICRO_TCP_LOG_WARNING("Response not sent", "the response to this request has already been sent");
+                return false;
+            }
+            state_->completion_(std::move(response));
+            return true;
+        }
+
+        /**
+         * @brief
+         *
+         * @return True if a response has been sent.
+         */
+        bool is_sent() const
+        {
+            return !state_ || state_->sent_.load();
+        }
+
+    private:
+        struct state
+        {
+            explicit state(completion_type completion) :
+                    completion_(std::move(completion)),
+                    sent_(false)
+            {
+                /*...*/
+            }
+
+            ~state()
+            {
+                if (!sent_.load())
+                {
+                    completion_(micro_tcp::message());
+                }
+            }
+
+            completion_type completion_;
+            std::atomic<bool> sent_;
+        };
+
+        std::shared_ptr<state> state_;
+    };
+}
+
+#endif
@@ -29,6 +29,7 @@
 #include <micro_tcp/files.hpp>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 namespace micro_tcp
 {
@@ -39,10 +40,57 @@ namespace micro_tcp
     class response_handler
     {
     public:
-        response_handler() = default;
+        /**
+         * @brief Responses with more content bytes than this are streamed to a file by default.
+         */
+        static constexpr std::uint64_t default_content_sink_threshold_ = 10000;
+
+        response_handler() :
+                content_sink_threshold_(default_content_sink_threshold_)
+        {
+            /*...*/
+        }
 
         ~response_handler() = default;
 
+        /**
+         * @brief Called once the header of a response has been read. Return an opened file_sink to have the
+         * content written to it chunk by chunk as it arrives, instead of being read into
+         * response.content_buffer_. Return nullptr to read the content into memory. Not called for compressed
+         * content, which is always read into memory and decompressed there; peers only compress content of up to
+         * compression_options::max_size_ bytes.
+         *
+         * @param response The response, only the header has been read.
+         * @param content_length The content length announced in the header.
+         * @return An opened sink or nullptr.
+         */
+        inline virtual std::unique_ptr<micro_tcp::file_sink> open_content_sink(const micro_tcp::message& /*response*/,
+                                                                                std::uint64_t content_length)
+        {
+            if (content_length > content_sink_threshold_)
+            {
+                auto sink = std::make_unique<micro_tcp::file_sink>();
+                if (sink->open("test.out"))
+                {
+                    return sink;
+                }
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief Called for a response whose content has been written to a sink returned by
+         * response_handler::open_content_sink(). The sink is closed and the file is complete.
+         *
+         * @param response The response, its content buffer is empty.
+         * @param sink The closed sink.
+         */
+        inline virtual void handle_response(const micro_tcp::message& /*response*/, const micro_tcp::file_sink& sink)
+        {
+            std::cout << "CLIENT | Received content was larger then " << content_sink_threshold_
+                      << ". Written to file: " << sink.path() << std::endl;
+        }
+
         inline virtual void handle_response(const micro_tcp::message& response)
         {
             if (response.content_buffer_.size() > 10000)
@@ -59,6 +107,29 @@ namespace micro_tcp
                           << std::string(response.content_buffer_.begin(), response.content_buffer_.end()) << std::endl;
             }
         }
+
+        /**
+         * @brief
+         *
+         * @param threshold Content length above which response_handler::open_content_sink() opens a sink.
+         */
+        void set_content_sink_threshold(std::uint64_t threshold)
+        {
+            content_sink_threshold_ = threshold;
+        }
+
+        /**
+         * @brief
+         *
+         * @return
+         */
+        std::uint64_t get_content_sink_threshold() const
+        {
+            return content_sink_threshold_;
+        }
+
+    protected:
+        std::uint64_t content_sink_threshold_;
     };
 }
 
@@ -24,21 +24,124 @@
 
 #include <micro_tcp/server.hpp>
 #include <micro_tcp/server_session.hpp>
+#include <micro_tcp/logger.hpp>
+#include <micro_tcp/local_endpoint.hpp>
 #include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <algorithm>
-#include <boost/date_time.hpp>
+#include <atomic>
+#include <sstream>
 
 namespace micro_tcp
 {
+    namespace
+    {
+        /**
+         * @brief Remove the file of a Unix domain socket, unless [path] is in the abstract namespace or names
+         * anything else than a socket.
+         */
+        void remove_socket_file(const std::string& path)
+        {
+            boost::system::error_code ec;
+            if (!path.empty() && path.front() != '@' &&
+                boost::filesystem::status(path, ec).type() == boost::filesystem::socket_file)
+            {
+                boost::filesystem::remove(path, ec);
+            }
+        }
+
+#ifdef SO_REUSEPORT
+        /**
+         * @brief The SO_REUSEPORT socket option, as a Boost.Asio SettableSocketOption.
+         */
+        struct reuse_port_option
+        {
+            explicit reuse_port_option(bool enabled) :
+                    value_(enabled ? 1 : 0)
+            {
+                /*...*/
+            }
+
+            template<typename Protocol>
+            int level(const Protocol& /*protocol*/) const
+            {
+                return SOL_SOCKET;
+            }
+
+            template<typename Protocol>
+            int name(const Protocol& /*protocol*/) const
+            {
+                return SO_REUSEPORT;
+            }
+
+            template<typename Protocol>
+            const int *data(const Protocol& /*protocol*/) const
+            {
+                return &value_;
+            }
+
+            template<typename Protocol>
+            std::size_t size(const Protocol& /*protocol*/) const
+            {
+                return sizeof(value_);
+            }
+
+            int value_;
+        };
+#endif
+    }
+
+    /**
+     * @brief An acceptor with its own accept loop and counters.
+     */
+    struct server::listener
+    {
+        listener(boost::asio::io_service& io_service, std::size_t io_index) :
+                acceptor_(io_service),
+                resume_timer_(io_service),
+                io_index_(io_index),
+                listening_since_(std::chrono::steady_clock::now())
+        {
+            /*...*/
+        }
+
+        acceptor_type acceptor_;
+        boost::asio::steady_timer resume_timer_; /*!< Resumes accepting after a pause. */
+        std::size_t io_index_; /*!< io_service of the sessions or server::any_io_service_. */
+        std::chrono::steady_clock::time_point listening_since_;
+        std::atomic<std::uint64_t> accepts_{0};
+        std::atomic<std::uint64_t> handshake_starts_{0};
+        std::atomic<std::uint64_t> handshake_start_latency_total_{0}; /*!< Microseconds. */
+        std::atomic<std::uint64_t> handshake_start_latency_max_{0}; /*!< Microseconds. */
+        std::atomic<std::uint64_t> pauses_{0};
+        std::atomic<std::uint64_t> rejects_{0};
+        std::atomic<std::uint64_t> accept_errors_{0};
+    };
+
+    /*static*/constexpr std::size_t server::any_io_service_;
+    /*static*/constexpr std::chrono::milliseconds server::admission_retry_interval_;
+    /*static*/const micro_tcp::session::timeouts server::default_timeouts_ = {std::chrono::seconds(10),
+                                                                              std::chrono::minutes(5),
+                                                                              std::chrono::seconds(10),
+                                                                              std::chrono::seconds(30)};
+
     server::server(boost::asio::io_service& io_service, const std::string& address, unsigned short port,
                    micro_tcp::request_handler& request_handler, boost::asio::ssl::context& context,
                    const std::string& cipher_suite) :
             context_(context),
             io_strand_(io_service),
-            acceptor_(io_service),
-            socket_(io_service),
+            session_manager_(std::make_shared<micro_tcp::session_manager>()),
             endpoint_(boost::asio::ip::address::from_string(address), port),
-            request_handler_(request_handler)
+            request_handler_(request_handler),
+            timeouts_(default_timeouts_),
+            max_content_length_(micro_tcp::message::default_max_content_length_),
+            io_manager_(nullptr),
+            worker_pool_(nullptr),
+            reuse_port_(false),
+            transport_(micro_tcp::transport::secure),
+            admission_limits_{0, 0},
+            accept_tokens_(0.0)
     {
         SSL_CTX_set_cipher_list(context_.native_handle(), cipher_suite.c_str());
     }
@@ -48,10 +151,17 @@ namespace micro_tcp
                    const std::string& cipher_suite) :
             context_(context),
             io_strand_(io_service),
-            acceptor_(io_service),
-            socket_(io_service),
+            session_manager_(std::make_shared<micro_tcp::session_manager>()),
             endpoint_(endpoint),
-            request_handler_(request_handler)
+            request_handler_(request_handler),
+            timeouts_(default_timeouts_),
+            max_content_length_(micro_tcp::message::default_max_content_length_),
+            io_manager_(nullptr),
+            worker_pool_(nullptr),
+            reuse_port_(false),
+            transport_(micro_tcp::transport::secure),
+            admission_limits_{0, 0},
+            accept_tokens_(0.0)
     {
         SSL_CTX_set_cipher_list(context_.native_handle(), cipher_suite.c_str());
     }
@@ -68,65 +178,240 @@ namespace micro_tcp
 
     void server::stop()
     {
-        acceptor_.close();
+        for (auto& listener : listeners_)
+        {
+            boost::system::error_code ec;
+            listener->acceptor_.close(ec);
+        }
+        if (!listeners_.empty())
+        {
+            remove_socket_file(local_path_);
+        }
+    }
+
+    std::size_t server::shutdown(std::chrono::milliseconds drain_timeout)
+    {
+        stop();
+        const auto closed = session_manager_->drain(drain_timeout);
+        MICRO_TCP_LOG_INFO("SERVER | drained, " + std::to_string(closed) + " session(s) closed after the drain timeout.");
+        return closed;
+    }
+
+    std::size_t server::get_session_count() const
+    {
+        return session_manager_->get_session_count();
     }
 
     bool server::is_listening()
     {
-        return acceptor_.is_open();
+        return !listeners_.empty() && listeners_.front()->acceptor_.is_open();
     }
 
-    void server::do_accept()
+    void server::do_accept(std::shared_ptr<listener> listener)
     {
-        acceptor_.async_accept(socket_, [this](boost::system::error_code ec)
+        const auto pause = admit_accept();
+        if (pause != std::chrono::steady_clock::duration::zero())
+        {
+            // Leave new connections in the listen backlog until the limits allow accepting again.
+            listener->pauses_.fetch_add(1, std::memory_order_relaxed);
+            pause_accept(std::move(listener), pause);
+            return;
+        }
+        auto assignment = !io_manager_ ? io_manager::assignment{&listener->acceptor_.get_io_service(), nullptr, false}
+                                       : listener->io_index_ == any_io_service_
+                                         ? io_manager_->assign_io_service()
+                                         : io_manager_->assign_io_service(listener->io_index_);
+        auto socket = std::make_shared<boost::asio::generic::stream_protocol::socket>(*assignment.io_service_);
+        listener->acceptor_.async_accept(*socket, [this, listener, socket, assignment](boost::system::error_code ec)
         {
-            if (!acceptor_.is_open())
+            if (!listener->acceptor_.is_open())
             {
-                debug("SERVER | stopped listening");
+                MICRO_TCP_LOG_INFO("SERVER | stopped listening");
                 return;
             }
-            if (!ec)
+            if (!ec && admission_limits_.max_sessions_ != 0 &&
+                session_manager_->get_session_count() >= admission_limits_.max_sessions_)
             {
-                std::make_shared<server_session>(std::move(socket_), context_, request_handler_)->start();
+                // Another acceptor admitted the last free session at the same time.
+                listener->rejects_.fetch_add(1, std::memory_order_relaxed);
+                boost::system::error_code close_ec;
+                socket->close(close_ec);
+            }
+            else if (!ec)
+            {
+                listener->accepts_.fetch_add(1, std::memory_order_relaxed);
+                auto session = std::make_shared<server_session>(std::move(*socket), context_, request_handler_);
+                session->set_compression_options(compression_options_);
+                session->set_timeouts(timeouts_);
+                session->set_max_content_length(max_content_length_);
+                session->set_transport(transport_);
+                session->set_single_threaded(assignment.single_threaded_);
+                session->set_io_lease(assignment.lease_);
+                session->set_worker_pool(worker_pool_);
+                session->set_session_manager(session_manager_);
+                session_manager_->add(session);
+                const auto accepted = std::chrono::steady_clock::now();
+                assignment.io_service_->dispatch([listener, session, accepted]()
+                {
+                    const auto latency = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - accepted).count());
+                    listener->handshake_starts_.fetch_add(1, std::memory_order_relaxed);
+                    listener->handshake_start_latency_total_.fetch_add(latency, std::memory_order_relaxed);
+                    auto max = listener->handshake_start_latency_max_.load(std::memory_order_relaxed);
+                    while (latency > max &&
+                           !listener->handshake_start_latency_max_.compare_exchange_weak(max, latency,
+                                                                                         std::memory_order_relaxed))
+                    {
+                        /*...*/
+                    }
+                    session->start();
+                });
             }
             else if (ec != boost::asio::error::operation_aborted)
             {
-                debug("Error on asynchronous accept", ec.message());
+                // E.g. out of file descriptors or memory: retrying right away would spin until resources are freed.
+                MICRO_TCP_LOG_ERROR("Error on asynchronous accept", ec.message());
+                listener->accept_errors_.fetch_add(1, std::memory_order_relaxed);
+                pause_accept(listener, admission_retry_interval_);
+                return;
+            }
+            do_accept(listener);
+        });
+    }
+
+    void server::pause_accept(std::shared_ptr<listener> listener, std::chrono::steady_clock::duration pause)
+    {
+        listener->resume_timer_.expires_from_now(pause);
+        listener->resume_timer_.async_wait([this, listener](const boost::system::error_code& ec)
+        {
+            if (!ec && listener->acceptor_.is_open())
+            {
+                do_accept(listener);
             }
-            do_accept();
         });
     }
 
     void server::start_listening()
     {
-        if (!acceptor_.is_open())
+        if (!is_listening())
         {
-            boost::system::error_code ec;
-            acceptor_.open(endpoint_.protocol(), ec);
-            if (ec)
+            // One acceptor per io thread with SO_REUSEPORT, each on the io_service of its thread in the
+            // io_service-per-thread model, so the kernel spreads new connections over the threads.
+            std::size_t count = 1;
+            bool per_thread = false;
+            if (reuse_port_ && io_manager_ && local_path_.empty())
             {
-                debug("Opening acceptor failed", ec.message());
+                count = std::max<std::size_t>(io_manager_->get_thread_count(), 1);
+                per_thread = io_manager_->get_threading_model() == io_manager::threading_model::io_service_per_thread;
             }
-            acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
-            if (ec)
+            listeners_.clear();
+            for (std::size_t index = 0; index < count; ++index)
+            {
+                auto& io_service = per_thread ? io_manager_->get_io_service(index) : io_strand_.get_io_service();
+                listeners_.push_back(std::make_shared<listener>(io_service, per_thread ? index : any_io_service_));
+                if (!open_acceptor(listeners_.back()->acceptor_))
+                {
+                    listeners_.pop_back();
+                    break;
+                }
+            }
+            if (listeners_.empty())
+            {
+                MICRO_TCP_LOG_ERROR("SERVER | could not listen on <" + get_address_port() + ">", "no acceptor opened");
+                return;
+            }
+            MICRO_TCP_LOG_INFO("SERVER | started listening on <" + get_address_port() + "> with "
+                               + std::to_string(listeners_.size()) + " acceptor(s).");
+            for (auto& listener : listeners_)
             {
-                debug("Setting acceptor option failed", ec.message());
+                do_accept(listener);
             }
-            acceptor_.bind(endpoint_, ec);
+        }
+    }
+
+    std::chrono::steady_clock::duration server::admit_accept()
+    {
+        if (admission_limits_.max_sessions_ != 0 &&
+            session_manager_->get_session_count() >= admission_limits_.max_sessions_)
+        {
+            return admission_retry_interval_;
+        }
+        if (admission_limits_.max_accept_rate_ == 0)
+        {
+            return std::chrono::steady_clock::duration::zero();
+        }
+        const double rate = admission_limits_.max_accept_rate_;
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(admission_mutex_);
+        const std::chrono::duration<double> elapsed = now - accept_tokens_refilled_;
+        accept_tokens_ = std::min(rate, accept_tokens_ + elapsed.count() * rate);
+        accept_tokens_refilled_ = now;
+        if (accept_tokens_ >= 1.0)
+        {
+            accept_tokens_ -= 1.0;
+            return std::chrono::steady_clock::duration::zero();
+        }
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>((1.0 - accept_tokens_) / rate));
+    }
+
+    bool server::open_acceptor(acceptor_type& acceptor)
+    {
+        boost::system::error_code ec;
+        boost::asio::generic::stream_protocol::endpoint endpoint(endpoint_);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        if (!local_path_.empty())
+        {
+            remove_socket_file(local_path_);
+            endpoint = micro_tcp::make_local_endpoint(local_path_);
+        }
+#endif
+        acceptor.open(endpoint.protocol(), ec);
+        if (ec)
+        {
+            MICRO_TCP_LOG_ERROR("Opening acceptor failed", ec.message());
+            return false;
+        }
+        if (local_path_.empty())
+        {
+            acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec);
             if (ec)
             {
-                debug("Binding acceptor to local endpoint failed", ec.message());
+                MICRO_TCP_LOG_ERROR("Setting acceptor option failed", ec.message());
+                acceptor.close(ec);
+                return false;
             }
-            acceptor_.listen(boost::asio::socket_base::max_connections, ec);
+        }
+        if (reuse_port_ && local_path_.empty())
+        {
+#ifdef SO_REUSEPORT
+            acceptor.set_option(reuse_port_option(true), ec);
+#else
+            ec = boost::asio::error::operation_not_supported;
+#endif
             if (ec)
             {
-                debug("Start listening for new connections failed", ec.message());
+                MICRO_TCP_LOG_ERROR("Setting acceptor option SO_REUSEPORT failed", ec.message());
+                acceptor.close(ec);
+                return false;
             }
-            std::ostringstream oss;
-            oss << "SERVER | started listening on <" << get_address_port() << ">.";
-            debug(oss.str());
-            do_accept();
         }
+        acceptor.bind(endpoint, ec);
+        if (ec)
+        {
+            MICRO_TCP_LOG_ERROR("Binding acceptor to local endpoint failed", ec.message());
+            acceptor.close(ec);
+            return false;
+        }
+        acceptor.listen(boost::asio::socket_base::max_connections, ec);
+        if (ec)
+        {
+            MICRO_TCP_LOG_ERROR("Start listening for new connections failed", ec.message());
+            acceptor.close(ec);
+            remove_socket_file(local_path_);
+            return false;
+        }
+        return true;
     }
 
     bool server::set_address(const std::string& address)
@@ -139,13 +424,13 @@ namespace micro_tcp
     bool server::set_address(const boost::asio::ip::address& address)
     {
         endpoint_.address(address);
-        if (acceptor_.is_open())
+        if (is_listening())
         {
-            debug("Could not change the address", "Stop the server before making any changes");
+            MICRO_TCP_LOG_WARNING("Could not change the address", "Stop the server before making any changes");
             return false;
         }
         endpoint_.address(address);
-        debug("SERVER | address set to " + get_address());
+        MICRO_TCP_LOG_INFO("SERVER | address set to " + get_address());
         return true;
     }
 
@@ -156,18 +441,18 @@ namespace micro_tcp
 
     bool server::set_port(unsigned short port)
     {
-        if (acceptor_.is_open())
+        if (is_listening())
         {
-            debug("Could not change the port", "Stop the server before making any changes");
+            MICRO_TCP_LOG_WARNING("Could not change the port", "Stop the server before making any changes");
             return false;
         }
         if (port_in_use(port))
         {
-            debug("Could not change the port", "port " + std::to_string(port) + " is already in use by another service");
+            MICRO_TCP_LOG_WARNING("Could not change the port", "port " + std::to_string(port) + " is already in use by another service");
             return false;
         }
         endpoint_.port(port);
-        debug("SERVER | port set to " + std::to_string(get_port()));
+        MICRO_TCP_LOG_INFO("SERVER | port set to " + std::to_string(get_port()));
         return true;
     }
 
@@ -178,6 +463,10 @@ namespace micro_tcp
 
     std::string server::get_address_port() const
     {
+        if (!local_path_.empty())
+        {
+            return local_path_;
+        }
         std::ostringstream oss;
         oss << get_address() << ':' << get_port();
         return oss.str();
@@ -185,27 +474,153 @@ namespace micro_tcp
 
     bool server::set_endpoint(const boost::asio::ip::tcp::endpoint& endpoint)
     {
-        if (acceptor_.is_open())
+        if (is_listening())
         {
-            debug("Could not change the endpoint", "Stop the server before making any changes");
+            MICRO_TCP_LOG_WARNING("Could not change the endpoint", "Stop the server before making any changes");
             return false;
         }
         endpoint_ = endpoint;
-        debug("SERVER | endpoint set to <" + get_address_port() + ">.");
+        MICRO_TCP_LOG_INFO("SERVER | endpoint set to <" + get_address_port() + ">.");
         return true;
     }
 
+    bool server::set_local_path(const std::string& path)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the local path", "Stop the server before making any changes");
+            return false;
+        }
+#if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        if (!path.empty())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the local path", "Unix domain sockets are not supported");
+            return false;
+        }
+#endif
+        local_path_ = path;
+        MICRO_TCP_LOG_INFO("SERVER | endpoint set to <" + get_address_port() + ">.");
+        return true;
+    }
+
+    std::string server::get_local_path() const
+    {
+        return local_path_;
+    }
+
     bool server::set_request_handler(micro_tcp::request_handler& request_handler)
     {
-        if (acceptor_.is_open())
+        if (is_listening())
         {
-            debug("Could not change the request_handler", "Stop the server before making any changes");
+            MICRO_TCP_LOG_WARNING("Could not change the request_handler", "Stop the server before making any changes");
             return false;
         }
         request_handler_ = request_handler;
         return true;
     }
 
+    void server::set_compression_options(const micro_tcp::compression_options& options)
+    {
+        compression_options_ = options;
+    }
+
+    void server::set_timeouts(const micro_tcp::session::timeouts& timeouts)
+    {
+        timeouts_ = timeouts;
+    }
+
+    void server::set_max_content_length(std::uint64_t max_content_length)
+    {
+        max_content_length_ = max_content_length;
+    }
+
+    bool server::set_io_manager(micro_tcp::io_manager& io_manager)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the io_manager", "Stop the server before making any changes");
+            return false;
+        }
+        io_manager_ = &io_manager;
+        return true;
+    }
+
+    bool server::set_worker_pool(micro_tcp::worker_pool& worker_pool)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the worker_pool", "Stop the server before making any changes");
+            return false;
+        }
+        worker_pool_ = &worker_pool;
+        return true;
+    }
+
+    bool server::set_reuse_port(bool reuse_port)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change SO_REUSEPORT", "Stop the server before making any changes");
+            return false;
+        }
+        reuse_port_ = reuse_port;
+        return true;
+    }
+
+    bool server::set_transport(micro_tcp::transport transport)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the transport", "Stop the server before making any changes");
+            return false;
+        }
+        transport_ = transport;
+        return true;
+    }
+
+    micro_tcp::transport server::get_transport() const
+    {
+        return transport_;
+    }
+
+    bool server::set_admission_limits(const admission_limits& limits)
+    {
+        if (is_listening())
+        {
+            MICRO_TCP_LOG_WARNING("Could not change the admission limits", "Stop the server before making any changes");
+            return false;
+        }
+        admission_limits_ = limits;
+        accept_tokens_ = limits.max_accept_rate_;
+        accept_tokens_refilled_ = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    std::vector<server::acceptor_statistics> server::get_acceptor_statistics() const
+    {
+        std::vector<acceptor_statistics> statistics;
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& listener : listeners_)
+        {
+            acceptor_statistics acceptor;
+            acceptor.accepts_ = listener->accepts_.load(std::memory_order_relaxed);
+            const std::chrono::duration<double> listening = now - listener->listening_since_;
+            acceptor.accept_rate_ = listening.count() > 0.0 ? static_cast<double>(acceptor.accepts_) / listening.count()
+                                                            : 0.0;
+            acceptor.handshake_starts_ = listener->handshake_starts_.load(std::memory_order_relaxed);
+            acceptor.average_handshake_start_latency_ = std::chrono::microseconds(
+                    acceptor.handshake_starts_ != 0 ? listener->handshake_start_latency_total_.load(
+                            std::memory_order_relaxed) / acceptor.handshake_starts_ : 0);
+            acceptor.max_handshake_start_latency_ = std::chrono::microseconds(
+                    listener->handshake_start_latency_max_.load(std::memory_order_relaxed));
+            acceptor.pauses_ = listener->pauses_.load(std::memory_order_relaxed);
+            acceptor.rejects_ = listener->rejects_.load(std::memory_order_relaxed);
+            acceptor.accept_errors_ = listener->accept_errors_.load(std::memory_order_relaxed);
+            statistics.push_back(acceptor);
+        }
+        return statistics;
+    }
+
     bool server::port_in_use(unsigned short port)
     {
         boost::asio::ip::tcp::acceptor acceptor(io_strand_.get_io_service());
@@ -235,21 +650,4 @@ namespace micro_tcp
         });
         return addresses;
     }
-
-    void server::debug(const std::string& msg, const std::string& ec)
-    {
-        std::ostringstream oss;
-        boost::posix_time::time_facet *facet(new boost::posix_time::time_facet(std::string("%Y-%m-%d %H:%M:%S.%f").c_str()));
-        oss.imbue(std::locale(oss.getloc(), facet));
-        oss << boost::posix_time::microsec_clock::local_time() << " | " << '[' << "host:port" << "] | " << msg;
-        if (!ec.empty())
-        {
-            oss << " | Error code: " << ec;
-            std::cerr << oss.str() << '\n';
-        }
-        else
-        {
-            std::cout << oss.str() << '\n';
-        }
-    }
 }
\ No newline at end of file
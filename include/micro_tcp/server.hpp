@@ -26,26 +26,67 @@
 #define MICRO_TCP_SERVER_HPP
 
 #include <micro_tcp/request_handler.hpp>
+#include <micro_tcp/compression.hpp>
+#include <micro_tcp/io_manager.hpp>
+#include <micro_tcp/worker_pool.hpp>
+#include <micro_tcp/session_manager.hpp>
+#include <micro_tcp/session.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl/stream.hpp>
-
-/**
- * todo: CRITICAL | when stopping the server with active sessions, the sessions will continue until the io_service
- * is stopped. Add a session_manager to the party.
- */
-
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace micro_tcp
 {
     class server
     {
     public:
+        /**
+         * @brief Counters of a single acceptor.
+         */
+        struct acceptor_statistics
+        {
+            std::uint64_t accepts_; /*!< Accepted connections. */
+            double accept_rate_; /*!< Accepted connections per second since listening started. */
+            std::uint64_t handshake_starts_; /*!< Sessions that started their secure handshake. */
+            std::chrono::microseconds average_handshake_start_latency_; /*!< From accept to handshake start. */
+            std::chrono::microseconds max_handshake_start_latency_; /*!< From accept to handshake start. */
+            std::uint64_t pauses_; /*!< Pauses of accepting because a limit was reached, one per retry. */
+            std::uint64_t rejects_; /*!< Connections closed right after accepting because the session limit was reached. */
+            std::uint64_t accept_errors_; /*!< Failed accepts (e.g. out of file descriptors), each pauses accepting. */
+        };
+
+        /**
+         * @brief Limits on admitting new connections. While a limit is reached the acceptors stop accepting, so new
+         * connections wait in the listen backlog of the kernel instead of competing with the live sessions.
+         */
+        struct admission_limits
+        {
+            std::size_t max_sessions_; /*!< Maximum amount of live sessions, 0 for no limit. */
+            std::uint32_t max_accept_rate_; /*!< Maximum accepts per second (with a burst of one second), 0 for no limit. */
+        };
+
+        /**
+         * @brief How long accepting is paused while the session limit is reached, or after a failed accept.
+         */
+        static constexpr std::chrono::milliseconds admission_retry_interval_{50};
+
         /**
          * @brief AES-256-GCM (Galois/Counter operation mode).
          */
         static constexpr auto default_cipher_suite_ = "EECDH+AESGCM:EDH+AESGCM:AES256+EECDH:AES256+EDH";
 
+        /**
+         * @brief Default deadlines of new sessions: 10 s for the handshake, 5 min idle between requests, 10 s for a
+         * header and 30 s without progress while reading content.
+         */
+        static const micro_tcp::session::timeouts default_timeouts_;
+
         /**
          * @brief Non-copyable - delete copy constructor.
          */
@@ -94,10 +135,28 @@ namespace micro_tcp
         void start();
 
         /**
-         * @brief
+         * @brief Stop accepting new connections. Sessions already accepted keep running, see server::shutdown().
          */
         void stop();
 
+        /**
+         * @brief Stop accepting new connections, let every session finish the requests it has read within
+         * [drain_timeout] and close the sessions still alive after that. MUST NOT be called from an io thread.
+         *
+         * @param drain_timeout The time given to the sessions to finish their requests.
+         * @return The amount of sessions that had to be closed.
+         *
+         * @see session_manager::drain()
+         */
+        std::size_t shutdown(std::chrono::milliseconds drain_timeout);
+
+        /**
+         * @brief
+         *
+         * @return The amount of live sessions.
+         */
+        std::size_t get_session_count() const;
+
         /**
          * @brief
          *
@@ -112,7 +171,7 @@ namespace micro_tcp
          * @param address An IPv4 address string in a dotted decimal notation or an IPv6 address in hexadecimal notation.
          * @return True if the set was successful and false if an error occurred
          *
-         * @pre The server should be inactive as in "!acceptor_.is_open()".
+         * @pre The server should be inactive as in "!is_listening()".
          * @post Class member endpoint_ has been initialised with the value of parameter "address".
          */
         bool set_address(const std::string& address);
@@ -162,6 +221,25 @@ namespace micro_tcp
          */
         bool set_endpoint(const boost::asio::ip::tcp::endpoint& endpoint);
 
+        /**
+         * @brief Listen on a Unix domain stream socket instead of the TCP endpoint, for clients on the same host. A
+         * stale socket file at [path] is replaced. Combine with transport::plain to skip SSL/TLS as well.
+         *
+         * @param path A filesystem path, a name starting with '@' for the abstract namespace (Linux only) or an empty
+         * string to listen on the TCP endpoint again.
+         * @return False if the server is listening or Unix domain sockets are not supported on this platform.
+         *
+         * @see make_local_endpoint()
+         */
+        bool set_local_path(const std::string& path);
+
+        /**
+         * @brief
+         *
+         * @return The path of the Unix domain socket listened on, empty for TCP.
+         */
+        std::string get_local_path() const;
+
         /**
          * @brief
          *
@@ -170,6 +248,88 @@ namespace micro_tcp
          */
         bool set_request_handler(micro_tcp::request_handler& request_handler);
 
+        /**
+         * @brief Set the compression options of new sessions.
+         *
+         * @param options
+         */
+        void set_compression_options(const micro_tcp::compression_options& options);
+
+        /**
+         * @brief Set the deadlines of new sessions, a slow or silent peer is disconnected once one passes.
+         *
+         * @param timeouts The deadlines, zero disables a deadline.
+         */
+        void set_timeouts(const micro_tcp::session::timeouts& timeouts);
+
+        /**
+         * @brief Set the largest request content length new sessions accept, a request claiming more is rejected
+         * and its session stopped. By default message::default_max_content_length_.
+         *
+         * @param max_content_length The largest content length in bytes.
+         */
+        void set_max_content_length(std::uint64_t max_content_length);
+
+        /**
+         * @brief Let the io_manager assign an io_service to every accepted session, instead of running all sessions
+         * on the io_service of the acceptor. Required for io_manager::threading_model::io_service_per_thread.
+         *
+         * @param io_manager The io_manager, it MUST outlive the server and its sessions.
+         * @return False if the server is listening.
+         */
+        bool set_io_manager(micro_tcp::io_manager& io_manager);
+
+        /**
+         * @brief Run the request handler of every new session on a worker pool instead of the I/O threads. The
+         * request handler MUST then be safe to call from several threads at once.
+         *
+         * @param worker_pool The pool, it MUST outlive the server and its sessions.
+         * @return False if the server is listening.
+         */
+        bool set_worker_pool(micro_tcp::worker_pool& worker_pool);
+
+        /**
+         * @brief Listen with one SO_REUSEPORT acceptor per io thread of the io_manager, each with its own accept
+         * loop, so the kernel spreads new connections over the threads. With
+         * io_manager::threading_model::io_service_per_thread every acceptor runs on the io_service of its thread
+         * and its sessions stay on that io_service. Without an io_manager a single acceptor is opened.
+         *
+         * @param reuse_port True to open one SO_REUSEPORT acceptor per io thread.
+         * @return False if the server is listening.
+         */
+        bool set_reuse_port(bool reuse_port);
+
+        /**
+         * @brief Set the transport of new sessions, by default SSL/TLS. With transport::plain messages are sent
+         * without encryption and the SSL/TLS context is not used, use it on trusted links only.
+         *
+         * @param transport The transport.
+         * @return False if the server is listening.
+         */
+        bool set_transport(micro_tcp::transport transport);
+
+        /**
+         * @brief
+         *
+         * @return The transport of new sessions.
+         */
+        micro_tcp::transport get_transport() const;
+
+        /**
+         * @brief
+         *
+         * @param limits The limits on admitting new connections.
+         * @return False if the server is listening.
+         */
+        bool set_admission_limits(const admission_limits& limits);
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the counters of every acceptor, in the order of the io threads.
+         */
+        std::vector<acceptor_statistics> get_acceptor_statistics() const;
+
         /**
          * @brief
          *
@@ -187,16 +347,45 @@ namespace micro_tcp
         std::vector<std::string> get_local_addresses(bool only_ipv4 = false);
 
     private:
+        struct listener;
+
+        typedef boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol> acceptor_type;
+
         /**
-         * Just used for debugging.
-         * Todo: delete this function.
+         * @brief Value of listener::io_index_: let the io_manager assign an io_service to each session.
          */
-        void debug(const std::string& msg, const std::string& ec = "");
+        static constexpr std::size_t any_io_service_ = static_cast<std::size_t>(-1);
 
         /**
          * @brief
+         *
+         * @param listener The acceptor to accept the next connection on.
+         */
+        void do_accept(std::shared_ptr<listener> listener);
+
+        /**
+         * @brief Leave new connections in the listen backlog for a while, then call server::do_accept() again.
+         *
+         * @param listener The acceptor to pause.
+         * @param pause How long to pause.
+         */
+        void pause_accept(std::shared_ptr<listener> listener, std::chrono::steady_clock::duration pause);
+
+        /**
+         * @brief Open, configure, bind and listen on an acceptor for endpoint_, or for local_path_ if set.
+         *
+         * @param acceptor The acceptor.
+         * @return False if any step failed (including SO_REUSEPORT, if requested), the acceptor is then closed.
+         */
+        bool open_acceptor(acceptor_type& acceptor);
+
+        /**
+         * @brief Admit the next accept against server::admission_limits_, taking a token of the accept rate if
+         * admitted. Called from any io thread.
+         *
+         * @return Zero if the next connection may be accepted, otherwise the time to pause accepting.
          */
-        void do_accept();
+        std::chrono::steady_clock::duration admit_accept();
 
         /**
          * @brief
@@ -205,10 +394,22 @@ namespace micro_tcp
 
         boost::asio::ssl::context& context_;
         boost::asio::io_service::strand io_strand_;
-        boost::asio::ip::tcp::acceptor acceptor_;
-        boost::asio::ip::tcp::socket socket_;
+        std::vector<std::shared_ptr<listener>> listeners_; /*!< The acceptors, the first one is always present when listening. */
+        std::shared_ptr<micro_tcp::session_manager> session_manager_; /*!< Registry of the live sessions. */
         boost::asio::ip::tcp::endpoint endpoint_;
+        std::string local_path_; /*!< Unix domain socket listened on instead of endpoint_, if not empty. */
         micro_tcp::request_handler& request_handler_;
+        micro_tcp::compression_options compression_options_;
+        micro_tcp::session::timeouts timeouts_;
+        std::uint64_t max_content_length_;
+        micro_tcp::io_manager *io_manager_;
+        micro_tcp::worker_pool *worker_pool_;
+        bool reuse_port_;
+        micro_tcp::transport transport_;
+        admission_limits admission_limits_;
+        std::mutex admission_mutex_;
+        double accept_tokens_; /*!< Accept rate tokens, guarded by admission_mutex_. */
+        std::chrono::steady_clock::time_point accept_tokens_refilled_; /*!< Guarded by admission_mutex_. */
     };
 }
 
@@ -23,13 +23,27 @@
 ///
 
 #include <micro_tcp/server_session.hpp>
+#include <micro_tcp/session_manager.hpp>
+#include <micro_tcp/logger.hpp>
 
 namespace micro_tcp
 {
-    server_session::server_session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context,
-                                   request_handler& request_handler) :
+    /*static*/constexpr std::size_t server_session::max_queued_responses_;
+    /*static*/constexpr std::size_t server_session::max_requests_in_flight_;
+
+    server_session::server_session(boost::asio::generic::stream_protocol::socket socket,
+                                   boost::asio::ssl::context& context, request_handler& request_handler) :
             session(std::move(socket), context),
-            request_handler_(request_handler)
+            request_handler_(request_handler),
+            asynchronous_handler_(request_handler.is_asynchronous()),
+            protocol_version_negotiated_(false),
+            reading_paused_(false),
+            draining_(false),
+            drained_(false),
+            worker_pool_(nullptr),
+            next_request_sequence_(0),
+            next_response_sequence_(0),
+            requests_in_flight_(0)
     {
         /*...*/
     }
@@ -39,16 +53,87 @@ namespace micro_tcp
         do_secure_handshake(boost::asio::ssl::stream_base::server);
     }
 
+    server_session::~server_session()
+    {
+        if (session_manager_)
+        {
+            session_manager_->remove(this);
+        }
+    }
+
+    void server_session::set_worker_pool(micro_tcp::worker_pool *worker_pool)
+    {
+        worker_pool_ = worker_pool;
+    }
+
+    void server_session::set_session_manager(std::shared_ptr<micro_tcp::session_manager> session_manager)
+    {
+        session_manager_ = std::move(session_manager);
+    }
+
+    void server_session::drain()
+    {
+        auto self(shared_from_this());
+        io_strand_.dispatch([this, self]()
+        {
+            draining_ = true;
+            finish_drain();
+        });
+    }
+
+    void server_session::close()
+    {
+        auto self(shared_from_this());
+        io_strand_.dispatch([this, self]()
+        {
+            if (is_alive())
+            {
+                do_close_socket();
+            }
+        });
+    }
+
     void server_session::on_secure_handshake()
     {
-        debug("SERVER | secure handshake OK");
+        MICRO_TCP_LOG_INFO("SERVER | secure handshake OK");
+        /* The first read covers the shortest header (v2), a v1 header is completed in on_read_header() */
+        static_assert(message::header_length_v2_ <= message::magic_numbers_.size() + message::content_length_digits10_,
+                      "The v2 header must not be longer than the v1 header");
+        set_protocol_version(protocol_version::v2);
         read_buffer_.prepare_header_buffer_read();
         do_read_header();
     }
 
     void server_session::on_read_header()
     {
-        debug("SERVER | read request header OK");
+        if (!protocol_version_negotiated_)
+        {
+            protocol_version version;
+            if (!message::detect_protocol_version(read_buffer_.header_buffer_.data(), read_buffer_.header_buffer_.size(),
+                                                  version))
+            {
+                MICRO_TCP_LOG_WARNING("SERVER | Rejected request header", "unknown magic numbers");
+                stop();
+                return;
+            }
+            protocol_version_negotiated_ = true;
+            set_protocol_version(version);
+            const auto offset = read_buffer_.header_buffer_.size();
+            if (offset < message::header_length(version))
+            {
+                read_buffer_.header_buffer_.resize(message::header_length(version));
+                do_read_header(offset);
+                return;
+            }
+        }
+        if (!read_buffer_.is_valid_header(max_content_length_))
+        {
+            MICRO_TCP_LOG_WARNING("SERVER | Rejected request header", "invalid header or content length too large");
+            stop();
+            return;
+        }
+        MICRO_TCP_LOG_DEBUG("SERVER | read request header OK");
+        read_buffer_.decode_header_fields();
         read_buffer_.prepare_content_buffer_read();
         do_read_content();
         /* Wait for any incoming message of size read_buffer_.header_buffer_.size() */
@@ -56,41 +141,173 @@ namespace micro_tcp
 
     void server_session::on_read_content()
     {
-        debug("SERVER | read request content OK");
-        request_handler_.handle_request(read_buffer_, write_buffer_);
-        write_buffer_.prepare_header_buffer_write();
-        do_write_header();
+        MICRO_TCP_LOG_DEBUG("SERVER | read request content OK");
+        if (worker_pool_ || asynchronous_handler_)
+        {
+            dispatch_request();
+        }
+        else
+        {
+            micro_tcp::message response;
+            request_handler_.handle_request(read_buffer_, response);
+            send_response(read_buffer_.request_id_, std::move(response));
+        }
+        do_read_next_request();
     }
 
-    void server_session::on_write_header()
+    void server_session::dispatch_request()
     {
-        debug("SERVER | write response header OK");
-        write_buffer_.prepare_content_buffer_write();
-        do_write_content();
+        auto self(shared_from_this());
+        const auto sequence = next_request_sequence_++;
+        const auto request_id = read_buffer_.request_id_;
+        ++requests_in_flight_;
+        micro_tcp::responder responder([this, self, sequence, request_id](micro_tcp::message response)
+        {
+            io_strand_.dispatch([this, self, sequence, request_id, response = std::move(response)]() mutable
+            {
+                complete_request(sequence, request_id, std::move(response));
+            });
+        });
+        if (worker_pool_)
+        {
+            auto request = std::make_shared<micro_tcp::message>(std::move(read_buffer_));
+            worker_pool_->submit([this, self, request, responder]()
+            {
+                handle_request(*request, responder);
+            });
+        }
+        else
+        {
+            handle_request(read_buffer_, std::move(responder));
+        }
     }
 
-    void server_session::on_write_content()
+    void server_session::handle_request(const micro_tcp::message& request, micro_tcp::responder responder)
+    {
+        if (asynchronous_handler_)
+        {
+            request_handler_.handle_request_async(request, std::move(responder));
+        }
+        else
+        {
+            micro_tcp::message response;
+            request_handler_.handle_request(request, response);
+            responder.send(std::move(response));
+        }
+    }
+
+    void server_session::complete_request(std::uint64_t sequence, std::uint64_t request_id,
+                                          micro_tcp::message response)
+    {
+        --requests_in_flight_;
+        if (!is_alive())
+        {
+            return;
+        }
+        if (protocol_version_ == protocol_version::v2)
+        {
+            send_response(request_id, std::move(response));
+        }
+        else
+        {
+            completed_responses_.emplace(sequence, std::move(response));
+            auto next = completed_responses_.begin();
+            while (next != completed_responses_.end() && next->first == next_response_sequence_)
+            {
+                enqueue_write(std::move(next->second));
+                next = completed_responses_.erase(next);
+                ++next_response_sequence_;
+            }
+        }
+        if (reading_paused_)
+        {
+            do_read_next_request();
+        }
+    }
+
+    void server_session::send_response(std::uint64_t request_id, micro_tcp::message response)
     {
-        debug("SERVER | write response content OK");
+        response.request_id_ = request_id;
+        enqueue_write(std::move(response));
+    }
+
+    void server_session::do_read_next_request()
+    {
+        if (draining_)
+        {
+            finish_drain();
+            return;
+        }
+        if (write_queue_.size() >= max_queued_responses_ ||
+            requests_in_flight_ + completed_responses_.size() >= max_requests_in_flight_)
+        {
+            reading_paused_ = true;
+            return;
+        }
+        reading_paused_ = false;
         read_buffer_.clear();
-        write_buffer_.clear();
         read_buffer_.prepare_header_buffer_read();
         do_read_header();
     }
 
+    void server_session::on_write_header()
+    {
+        MICRO_TCP_LOG_DEBUG("SERVER | write response header OK");
+    }
+
+    void server_session::on_write_content()
+    {
+        MICRO_TCP_LOG_DEBUG("SERVER | write response content OK");
+        write_buffer_.clear();
+        if (reading_paused_)
+        {
+            do_read_next_request();
+        }
+        if (draining_)
+        {
+            /* complete_write() is still writing */
+            auto self(shared_from_this());
+            io_strand_.post([this, self]()
+            {
+                finish_drain();
+            });
+        }
+    }
+
+    void server_session::finish_drain()
+    {
+        if (!drained_ && requests_in_flight_ == 0 && completed_responses_.empty() && write_queue_.empty() &&
+            !write_in_progress_ && is_alive())
+        {
+            drained_ = true;
+            stop();
+        }
+    }
+
     void server_session::on_shutdown_secure_stream()
     {
         auto self(shared_from_this());
-        boost::asio::async_write(secure_stream_, boost::asio::null_buffers(), io_strand_.wrap([this, self](
+        boost::asio::async_write(secure_stream_, boost::asio::null_buffers(), wrap_handler([this, self](
                 boost::system::error_code /*ec*/, std::size_t /*bytes_transferred*/)
         {
-            debug("SERVER | shutting down secure (SSL/TLS) protocol on stream OK");
+            MICRO_TCP_LOG_INFO("SERVER | shutting down secure (SSL/TLS) protocol on stream OK");
             do_close_socket();
         }));
     }
 
     void server_session::on_close_socket()
     {
-        debug("SERVER | socket close OK");
+        MICRO_TCP_LOG_INFO("SERVER | socket close OK");
+    }
+
+    void server_session::on_timeout()
+    {
+        if (timeout_phase_ == timeout_phase::idle &&
+            (requests_in_flight_ != 0 || !completed_responses_.empty() || write_in_progress_))
+        {
+            arm_timeout(timeout_phase::idle);
+            return;
+        }
+        session::on_timeout();
     }
 }
\ No newline at end of file
@@ -26,13 +26,42 @@
 
 #include <micro_tcp/session.hpp>
 #include <micro_tcp/request_handler.hpp>
+#include <micro_tcp/worker_pool.hpp>
+#include <map>
 
 namespace micro_tcp
 {
-    class server_session :
+    class session_manager;
+
+    /**
+     * @brief Server side of a session. Requests are read continuously: the response to a request is queued for
+     * writing (tagged with the request id) and the next request is read while earlier responses are still being
+     * written. Reading pauses while server_session::max_queued_responses_ responses are waiting.
+     *
+     * With a worker_pool the request handler runs on the pool instead of the I/O thread and the response is posted
+     * back to the strand. An asynchronous request handler (request_handler::is_asynchronous()) sends its response
+     * later through a responder, from any thread. In both cases the next requests are read meanwhile, up to
+     * server_session::max_requests_in_flight_ unanswered requests. v2 responses are sent as soon as they are complete, v1 responses are held back until the
+     * responses to all earlier requests have been sent, since v1 has no request id.
+     *
+     * A session registered in a session_manager stays registered until it is destroyed. server_session::drain()
+     * stops reading requests and shuts the session down once all requests it has read are answered.
+     */
+    class server_session final :
             public session
     {
     public:
+        /**
+         * @brief Maximum amount of queued responses before reading further requests is paused.
+         */
+        static constexpr std::size_t max_queued_responses_ = 64;
+
+        /**
+         * @brief Maximum amount of requests being handled on the worker pool or asynchronously before reading further
+         * requests is paused.
+         */
+        static constexpr std::size_t max_requests_in_flight_ = 4096;
+
         /**
          * @brief Non-copyable - delete copy constructor.
          */
@@ -49,14 +78,46 @@ namespace micro_tcp
          * @param context
          * @param request_handler
          */
-        explicit server_session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context,
-                                request_handler& request_handler);
+        explicit server_session(boost::asio::generic::stream_protocol::socket socket,
+                                boost::asio::ssl::context& context, request_handler& request_handler);
+
+        /**
+         * @brief Unregister the session from its session_manager, if any.
+         */
+        ~server_session() override;
 
         /**
          * @brief
          */
         void start() override;
 
+        /**
+         * @brief Run the request handler on a worker pool. MUST be called before server_session::start().
+         *
+         * @param worker_pool The pool, it MUST outlive the session. nullptr to handle requests on the I/O thread.
+         */
+        void set_worker_pool(micro_tcp::worker_pool *worker_pool);
+
+        /**
+         * @brief Unregister the session from [session_manager] when it is destroyed. MUST be called before
+         * server_session::start().
+         *
+         * @param session_manager The registry the session is added to.
+         */
+        void set_session_manager(std::shared_ptr<micro_tcp::session_manager> session_manager);
+
+        /**
+         * @brief Stop reading requests and shut the session down as soon as every request read so far has been
+         * answered. May be called from any thread.
+         */
+        void drain();
+
+        /**
+         * @brief Close the socket without waiting for outstanding requests or a secure shutdown. May be called from
+         * any thread.
+         */
+        void close();
+
     private:
         /**
          * @brief
@@ -83,6 +144,47 @@ namespace micro_tcp
          */
         void on_write_content() override;
 
+        /**
+         * @brief Queue a response to the request with the given id.
+         *
+         * @param request_id The request id of the request.
+         * @param response The response.
+         */
+        void send_response(std::uint64_t request_id, micro_tcp::message response);
+
+        /**
+         * @brief Hand read_buffer_ to the request handler, on the worker pool if there is one, with a responder that
+         * posts the response back to server_session::complete_request().
+         */
+        void dispatch_request();
+
+        /**
+         * @brief Call the synchronous or asynchronous request handler.
+         *
+         * @param request The request.
+         * @param responder The responder of the request.
+         */
+        void handle_request(const micro_tcp::message& request, micro_tcp::responder responder);
+
+        /**
+         * @brief Send a response produced off the strand, in request order for v1. Called from within the strand.
+         *
+         * @param sequence The sequence number of the request on this session.
+         * @param request_id The request id of the request.
+         * @param response The response.
+         */
+        void complete_request(std::uint64_t sequence, std::uint64_t request_id, micro_tcp::message response);
+
+        /**
+         * @brief Start reading the next request, unless too many responses are queued or requests are in flight.
+         */
+        void do_read_next_request();
+
+        /**
+         * @brief Shut the session down if it is draining and every request read has been answered and written.
+         */
+        void finish_drain();
+
         /**
          * @brief
          */
@@ -93,8 +195,25 @@ namespace micro_tcp
          */
         void on_close_socket() override;
 
+        /**
+         * @brief A peer waiting for its requests to be answered is not idle: the idle deadline is armed again while
+         * requests are in flight or responses are being written.
+         */
+        void on_timeout() override;
+
     private:
         micro_tcp::request_handler& request_handler_;
+        const bool asynchronous_handler_; /*!< request_handler::is_asynchronous(), queried once per session. */
+        bool protocol_version_negotiated_; /*!< Set once the protocol version is detected from the first request. */
+        bool reading_paused_; /*!< True while reading is paused because too many responses are queued. */
+        bool draining_; /*!< Set by server_session::drain(), no further requests are read. */
+        bool drained_; /*!< Set once the session has been stopped by server_session::finish_drain(). */
+        micro_tcp::worker_pool *worker_pool_; /*!< Pool running the request handler, if any. */
+        std::uint64_t next_request_sequence_; /*!< Sequence number of the next request read. */
+        std::uint64_t next_response_sequence_; /*!< Sequence number of the next v1 response to send. */
+        std::size_t requests_in_flight_; /*!< Requests being handled on the worker pool or asynchronously. */
+        std::map<std::uint64_t, micro_tcp::message> completed_responses_; /*!< v1 responses waiting for their turn. */
+        std::shared_ptr<micro_tcp::session_manager> session_manager_; /*!< Registry of the session, if any. */
     };
 }
 
@@ -23,16 +23,44 @@
 ///
 
 #include <micro_tcp/session.hpp>
+#include <micro_tcp/logger.hpp>
 #include <boost/asio/read.hpp>
-#include <iostream>
-#include <boost/date_time.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <atomic>
 
 namespace micro_tcp
 {
-    session::session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context) :
+    namespace
+    {
+        std::atomic<std::uint64_t> write_count{0};
+        std::atomic<std::uint64_t> frame_count{0};
+        std::atomic<std::uint64_t> full_handshake_count[2]; /*!< By handshake_type. */
+        std::atomic<std::uint64_t> resumed_handshake_count[2]; /*!< By handshake_type. */
+    }
+
+    /*static*/constexpr std::size_t session::max_linearized_write_size_;
+    /*static*/constexpr std::size_t session::max_coalesced_write_size_;
+    /*static*/constexpr std::size_t session::receive_buffer_size_;
+    /*static*/constexpr unsigned int session::max_read_dispatch_depth_;
+
+    session::session(boost::asio::generic::stream_protocol::socket socket, boost::asio::ssl::context& context) :
             socket_(std::move(socket)),
             secure_stream_(socket_, context),
-            io_strand_(secure_stream_.get_io_service())
+            io_strand_(secure_stream_.get_io_service()),
+            protocol_version_(message::default_protocol_version_),
+            receive_begin_(0),
+            receive_end_(0),
+            read_offset_(0),
+            read_dispatch_depth_(0),
+            write_file_offset_(0),
+            content_sink_remaining_(0),
+            write_in_progress_(false),
+            peer_codecs_(0),
+            timeout_timer_(io_strand_.get_io_service()),
+            timeouts_(),
+            timeout_phase_(timeout_phase::none),
+            max_content_length_(message::default_max_content_length_)
     {
         /*...*/
     }
@@ -42,105 +70,414 @@ namespace micro_tcp
     void session::do_secure_handshake(boost::asio::ssl::stream_base::handshake_type type)
     {
         auto self(shared_from_this());
-        secure_stream_.async_handshake(type, io_strand_.wrap([this, self](boost::system::error_code ec)
+        const auto disabled = std::chrono::milliseconds::zero();
+        if (timeouts_.handshake_ != disabled || timeouts_.idle_ != disabled || timeouts_.header_read_ != disabled ||
+            timeouts_.content_read_ != disabled)
+        {
+            std::weak_ptr<session> weak_self(self);
+            timeout_timer_.set_handler([this, weak_self]()
+            {
+                if (auto self = weak_self.lock())
+                {
+                    io_strand_.dispatch([this, self]()
+                    {
+                        if (timeout_timer_.has_expired() && is_alive())
+                        {
+                            on_timeout();
+                        }
+                    });
+                }
+            });
+            arm_timeout(timeout_phase::handshake);
+        }
+        secure_stream_.async_handshake(type, wrap_handler([this, self, type](boost::system::error_code ec)
         {
             if (!ec)
             {
+                cancel_timeout();
+                if (secure_stream_.is_enabled())
+                {
+                    auto& count = SSL_session_reused(secure_stream_.secure_stream().native_handle())
+                                  ? resumed_handshake_count : full_handshake_count;
+                    count[type].fetch_add(1, std::memory_order_relaxed);
+                }
                 on_secure_handshake();
             }
             else if (ec != boost::asio::error::operation_aborted)
             {
-                debug("Error on secure handshake", ec.message());
+                MICRO_TCP_LOG_ERROR("Error on secure handshake", ec.message());
                 do_close_socket();
             }
         }));
     }
 
-    void session::do_read_header()
+    void session::do_read_header(std::size_t offset)
+    {
+        read_offset_ = offset;
+        continue_read_header();
+    }
+
+    void session::continue_read_header()
+    {
+        auto& header = read_buffer_.header_buffer_;
+        const auto required = header.size() - read_offset_;
+        if (receive_end_ - receive_begin_ < required)
+        {
+            do_receive(&session::continue_read_header);
+            return;
+        }
+        std::copy_n(receive_buffer_.begin() + receive_begin_, required, header.begin() + read_offset_);
+        receive_begin_ += required;
+        read_offset_ = 0;
+        dispatch_read(&session::on_read_header);
+    }
+
+    void session::do_read_content()
+    {
+        read_offset_ = 0;
+        continue_read_content();
+    }
+
+    void session::continue_read_content()
+    {
+        auto& content = read_buffer_.content_buffer_;
+        const auto buffered = std::min(receive_end_ - receive_begin_, content.size() - read_offset_);
+        std::copy_n(receive_buffer_.begin() + receive_begin_, buffered, content.begin() + read_offset_);
+        receive_begin_ += buffered;
+        read_offset_ += buffered;
+
+        const auto remaining = content.size() - read_offset_;
+        if (remaining == 0)
+        {
+            read_offset_ = 0;
+            complete_read_content();
+        }
+        else if (remaining < receive_buffer_size_)
+        {
+            do_receive(&session::continue_read_content);
+        }
+        else
+        {
+            auto self(shared_from_this());
+            arm_timeout(timeout_phase::content_read);
+            boost::asio::async_read(secure_stream_, boost::asio::buffer(content.data() + read_offset_, remaining),
+                                    [this](const boost::system::error_code& ec, std::size_t bytes_transferred)
+            {
+                // Every partial read is progress, push the content deadline back.
+                if (bytes_transferred != 0 && timeout_phase_ == timeout_phase::content_read)
+                {
+                    arm_timeout(timeout_phase::content_read);
+                }
+                return boost::asio::transfer_all()(ec, bytes_transferred);
+            }, wrap_handler([this, self](boost::system::error_code ec, std::size_t /*bytes_transferred*/)
+            {
+                if (!ec)
+                {
+                    read_offset_ = 0;
+                    complete_read_content();
+                }
+                else if (ec != boost::asio::error::operation_aborted)
+                {
+                    if (ec != boost::asio::error::eof)
+                    {
+                        MICRO_TCP_LOG_ERROR("Error reading content", ec.message());
+                    }
+                    stop();
+                }
+            }));
+        }
+    }
+
+    void session::complete_read_content()
+    {
+        if (read_buffer_.version_ == protocol_version::v2)
+        {
+            peer_codecs_ = read_buffer_.accepted_codecs_;
+        }
+        if (!compression::decompress_content(read_buffer_, max_content_length_, compression_buffer_))
+        {
+            MICRO_TCP_LOG_ERROR("Error decompressing content", "corrupt, oversized or unsupported compressed content");
+            stop();
+            return;
+        }
+        cancel_timeout();
+        dispatch_read(&session::on_read_content);
+    }
+
+    void session::do_read_content_to_sink(std::uint64_t content_length)
     {
+        content_sink_remaining_ = content_length;
+        continue_read_content_to_sink();
+    }
+
+    void session::continue_read_content_to_sink()
+    {
+        const auto buffered = static_cast<std::size_t>(std::min<std::uint64_t>(receive_end_ - receive_begin_,
+                                                                               content_sink_remaining_));
+        if (buffered != 0 && !content_sink_->write(receive_buffer_.data() + receive_begin_, buffered))
+        {
+            MICRO_TCP_LOG_ERROR("Error writing content to sink", content_sink_->path());
+            stop();
+            return;
+        }
+        receive_begin_ += buffered;
+        content_sink_remaining_ -= buffered;
+
+        if (content_sink_remaining_ != 0)
+        {
+            do_receive(&session::continue_read_content_to_sink);
+        }
+        else if (content_sink_->close())
+        {
+            cancel_timeout();
+            dispatch_read(&session::on_read_content);
+        }
+        else
+        {
+            MICRO_TCP_LOG_ERROR("Error closing content sink", content_sink_->path());
+            stop();
+        }
+    }
+
+    void session::do_receive(void (session::*continuation)())
+    {
+        if (receive_begin_ == receive_end_)
+        {
+            receive_begin_ = receive_end_ = 0;
+        }
+        else if (receive_begin_ != 0)
+        {
+            std::copy(receive_buffer_.begin() + receive_begin_, receive_buffer_.begin() + receive_end_, receive_buffer_.begin());
+            receive_end_ -= receive_begin_;
+            receive_begin_ = 0;
+        }
+        if (receive_buffer_.size() != receive_buffer_size_)
+        {
+            receive_buffer_.resize(receive_buffer_size_);
+        }
+        if (continuation != &session::continue_read_header)
+        {
+            arm_timeout(timeout_phase::content_read);
+        }
+        else if (receive_end_ == 0 && read_offset_ == 0)
+        {
+            arm_timeout(timeout_phase::idle);
+        }
+        else if (timeout_phase_ != timeout_phase::header_read)
+        {
+            arm_timeout(timeout_phase::header_read);
+        }
+
         auto self(shared_from_this());
-        boost::asio::async_read(secure_stream_, boost::asio::buffer(read_buffer_.header_buffer_), io_strand_.wrap([this, self](
-                boost::system::error_code ec, std::size_t /*bytes_transferred*/)
+        secure_stream_.async_read_some(boost::asio::buffer(receive_buffer_.data() + receive_end_, receive_buffer_.size() - receive_end_),
+                                       wrap_handler([this, self, continuation](boost::system::error_code ec, std::size_t bytes_transferred)
         {
             if (!ec)
             {
-                on_read_header();
+                receive_end_ += bytes_transferred;
+                (this->*continuation)();
             }
             else if (ec != boost::asio::error::operation_aborted)
             {
                 if (ec != boost::asio::error::eof)
                 {
-                    debug("Error reading content", ec.message());
+                    MICRO_TCP_LOG_ERROR("Error reading from stream", ec.message());
                 }
                 stop();
             }
         }));
     }
 
-    void session::do_read_content()
+    void session::dispatch_read(void (session::*hook)())
+    {
+        if (read_dispatch_depth_ < max_read_dispatch_depth_)
+        {
+            ++read_dispatch_depth_;
+            (this->*hook)();
+            --read_dispatch_depth_;
+        }
+        else
+        {
+            auto self(shared_from_this());
+            io_strand_.post([this, self, hook]()
+            {
+                (this->*hook)();
+            });
+        }
+    }
+
+    void session::do_write_message()
     {
+        write_in_progress_ = true;
+        write_count.fetch_add(1, std::memory_order_relaxed);
+        if (write_buffer_.content_file_ && write_buffer_.content_file_->size() != 0)
+        {
+            frame_count.fetch_add(1, std::memory_order_relaxed);
+            write_file_offset_ = 0;
+            do_write_content_file(true);
+            return;
+        }
+
         auto self(shared_from_this());
-        boost::asio::async_read(secure_stream_, boost::asio::buffer(read_buffer_.content_buffer_), io_strand_.wrap([this, self](
+        const auto& header = write_buffer_.header_buffer_;
+        const auto& content = write_buffer_.content_buffer_;
+        std::array<boost::asio::const_buffer, 2> buffers;
+        if (header.size() + content.size() <= max_linearized_write_size_)
+        {
+            write_linear_buffer_.assign(header.begin(), header.end());
+            write_linear_buffer_.insert(write_linear_buffer_.end(), content.begin(), content.end());
+            coalesce_write_queue();
+            buffers = {{boost::asio::buffer(write_linear_buffer_), boost::asio::const_buffer()}};
+        }
+        else
+        {
+            buffers = {{boost::asio::buffer(header), boost::asio::buffer(content)}};
+        }
+        frame_count.fetch_add(1 + write_batch_.size(), std::memory_order_relaxed);
+        boost::asio::async_write(secure_stream_, buffers, wrap_handler([this, self](
                 boost::system::error_code ec, std::size_t /*bytes_transferred*/)
         {
             if (!ec)
             {
-                on_read_content();
+                on_write_header();
+                complete_write();
             }
             else if (ec != boost::asio::error::operation_aborted)
             {
-                if (ec != boost::asio::error::eof)
-                {
-                    debug("Error reading content", ec.message());
-                }
+                MICRO_TCP_LOG_ERROR("Error writing message", ec.message());
                 stop();
             }
         }));
     }
 
-    void session::do_write_header()
+    void session::do_write_content_file(bool with_header)
     {
-        auto self(shared_from_this());
-        boost::asio::async_write(secure_stream_, boost::asio::buffer(write_buffer_.header_buffer_, write_buffer_.header_buffer_.size()), io_strand_.wrap([this, self](
-                boost::system::error_code ec, std::size_t /*bytes_transferred*/)
+        const auto& file = *write_buffer_.content_file_;
+        const auto length = static_cast<std::size_t>(std::min<std::uint64_t>(mapped_file::window_size_,
+                                                                             file.size() - write_file_offset_));
+        write_file_window_ = file.map_window(write_file_offset_, length);
+        if (!write_file_window_)
         {
-        if (!ec)
-        {
-            on_write_header();
-        }
-        else if (ec != boost::asio::error::operation_aborted)
-        {
-            debug("Error writing header", ec.message());
+            MICRO_TCP_LOG_ERROR("Error writing content file", "mapping failed");
             stop();
+            return;
         }
-        }));
-    }
 
-    void session::do_write_content()
-    {
         auto self(shared_from_this());
-        boost::asio::async_write(secure_stream_, boost::asio::buffer(write_buffer_.content_buffer_, write_buffer_.content_buffer_.size()), io_strand_.wrap([this, self](
+        std::array<boost::asio::const_buffer, 2> buffers = {{
+                with_header ? boost::asio::buffer(write_buffer_.header_buffer_) : boost::asio::const_buffer(),
+                boost::asio::const_buffer(write_file_window_->get_address(), length)}};
+        boost::asio::async_write(secure_stream_, buffers, wrap_handler([this, self, with_header, length](
                 boost::system::error_code ec, std::size_t /*bytes_transferred*/)
         {
+            write_file_window_.reset();
             if (!ec)
             {
-                on_write_content();
+                if (with_header)
+                {
+                    on_write_header();
+                }
+                write_file_offset_ += length;
+                if (write_file_offset_ < write_buffer_.content_file_->size())
+                {
+                    do_write_content_file(false);
+                }
+                else
+                {
+                    write_buffer_.content_file_.reset();
+                    complete_write();
+                }
             }
             else if (ec != boost::asio::error::operation_aborted)
             {
-                debug("Error writing content", ec.message());
+                MICRO_TCP_LOG_ERROR("Error writing content file", ec.message());
                 stop();
             }
         }));
     }
 
+    void session::enqueue_write(micro_tcp::message message)
+    {
+        write_queue_.push_back(std::move(message));
+        if (!write_in_progress_)
+        {
+            do_write_next();
+        }
+    }
+
+    void session::do_write_next()
+    {
+        if (write_queue_.empty())
+        {
+            return;
+        }
+        std::swap(write_buffer_, write_queue_.front());
+        write_queue_.pop_front();
+        if (!prepare_write(write_buffer_))
+        {
+            MICRO_TCP_LOG_ERROR("Error writing message", "content length of " +
+                                std::to_string(write_buffer_.get_content_length()) +
+                                " bytes does not fit the header of the session's protocol version");
+            stop();
+            return;
+        }
+        do_write_message();
+    }
+
+    bool session::prepare_write(micro_tcp::message& message)
+    {
+        message.set_protocol_version(protocol_version_);
+        compression::compress_content(message, compression_options_, peer_codecs_, compression_buffer_);
+        return message.prepare_header_buffer_write();
+    }
+
+    void session::coalesce_write_queue()
+    {
+        const auto header_length = message::header_length(protocol_version_);
+        while (!write_queue_.empty())
+        {
+            // The uncompressed length bounds the length on the wire, compression only keeps smaller content.
+            const auto& next = write_queue_.front();
+            const auto length = header_length + next.content_buffer_.size();
+            if (next.content_file_ || length > max_linearized_write_size_ ||
+                write_linear_buffer_.size() + length > max_coalesced_write_size_)
+            {
+                break;
+            }
+            write_batch_.push_back(std::move(write_queue_.front()));
+            write_queue_.pop_front();
+
+            auto& frame = write_batch_.back();
+            prepare_write(frame); // Bounded by max_linearized_write_size_, fits the header of any version.
+            write_linear_buffer_.insert(write_linear_buffer_.end(), frame.header_buffer_.begin(),
+                                        frame.header_buffer_.end());
+            write_linear_buffer_.insert(write_linear_buffer_.end(), frame.content_buffer_.begin(),
+                                        frame.content_buffer_.end());
+        }
+    }
+
+    void session::complete_write()
+    {
+        // Hooks may queue new messages, these are written once every message of this write has been completed.
+        on_write_content();
+        for (auto& frame : write_batch_)
+        {
+            std::swap(write_buffer_, frame);
+            on_write_header();
+            on_write_content();
+        }
+        write_batch_.clear();
+        write_in_progress_ = false;
+        do_write_next();
+    }
+
     void session::stop()
     {
         boost::system::error_code ec;
         socket().cancel(ec);
         if (ec)
         {
-            debug("Error cancelling socket", ec.message());
+            MICRO_TCP_LOG_ERROR("Error cancelling socket", ec.message());
         }
         do_shutdown_secure_stream();
     }
@@ -148,7 +485,7 @@ namespace micro_tcp
     void session::do_shutdown_secure_stream()
     {
         auto self(shared_from_this());
-        secure_stream_.async_shutdown(io_strand_.wrap([this, self](const boost::system::error_code& ec)
+        secure_stream_.async_shutdown(wrap_handler([this, self](const boost::system::error_code& ec)
         {
             if (ec.category() != boost::asio::error::get_ssl_category())
             {
@@ -156,7 +493,7 @@ namespace micro_tcp
             }
             else
             {
-                debug("Failed to securely shut down the secure (SSL/TLS) protocol on the stream", ec.message());
+                MICRO_TCP_LOG_ERROR("Failed to securely shut down the secure (SSL/TLS) protocol on the stream", ec.message());
                 do_close_socket();
             }
         }));
@@ -164,6 +501,7 @@ namespace micro_tcp
 
     void session::do_close_socket()
     {
+        cancel_timeout();
         boost::system::error_code ec;
         socket().close(ec);
         if (!ec)
@@ -172,35 +510,117 @@ namespace micro_tcp
         }
         else
         {
-            debug("Error closing socket", ec.message());
+            MICRO_TCP_LOG_ERROR("Error closing socket", ec.message());
         }
     }
 
-    boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::next_layer_type& session::socket()
+    void session::set_compression_options(const micro_tcp::compression_options& options)
     {
-        return secure_stream_.next_layer();
+        compression_options_ = options;
     }
 
-    bool session::is_alive()
+    /*static*/session::write_statistics session::get_write_statistics()
     {
-        return socket().is_open();
+        return {write_count.load(std::memory_order_relaxed), frame_count.load(std::memory_order_relaxed)};
+    }
+
+    /*static*/session::handshake_statistics session::get_handshake_statistics(
+            boost::asio::ssl::stream_base::handshake_type type)
+    {
+        return {full_handshake_count[type].load(std::memory_order_relaxed),
+                resumed_handshake_count[type].load(std::memory_order_relaxed)};
+    }
+
+    void session::set_single_threaded(bool single_threaded)
+    {
+        io_strand_.set_enabled(!single_threaded);
+    }
+
+    void session::set_io_lease(std::shared_ptr<void> lease)
+    {
+        io_lease_ = std::move(lease);
+    }
+
+    void session::set_timeouts(const timeouts& timeouts)
+    {
+        timeouts_ = timeouts;
+    }
+
+    void session::set_max_content_length(std::uint64_t max_content_length)
+    {
+        max_content_length_ = max_content_length;
+    }
+
+    void session::set_transport(micro_tcp::transport transport)
+    {
+        secure_stream_.set_enabled(transport == micro_tcp::transport::secure);
+    }
+
+    micro_tcp::transport session::get_transport() const
+    {
+        return secure_stream_.is_enabled() ? micro_tcp::transport::secure : micro_tcp::transport::plain;
     }
 
-    void session::debug(const std::string& msg, const std::string& ec)
+    void session::on_timeout()
     {
-        std::ostringstream oss;
-        boost::posix_time::time_facet *facet(new boost::posix_time::time_facet(std::string("%Y-%m-%d %H:%M:%S.%f").c_str()));
-        oss.imbue(std::locale(oss.getloc(), facet));
-        oss << boost::posix_time::microsec_clock::local_time() << " | " << '[' << "host:port" << "] | " << msg;
-        if (!ec.empty())
+        static const char* const phases[] = {"none", "handshake", "idle", "header read", "content read"};
+        MICRO_TCP_LOG_WARNING("Session timed out", phases[static_cast<std::size_t>(timeout_phase_)]);
+        // The peer is unresponsive, do not wait for it to answer a secure shutdown.
+        do_close_socket();
+    }
+
+    void session::arm_timeout(timeout_phase phase)
+    {
+        const auto timeout = get_timeout(phase);
+        if (timeout != std::chrono::milliseconds::zero())
         {
-            oss << " | Error code: " << ec;
-            std::cerr << oss.str() << '\n';
+            timeout_timer_.arm(timeout);
         }
-        else
+        else if (get_timeout(timeout_phase_) != std::chrono::milliseconds::zero())
+        {
+            timeout_timer_.cancel();
+        }
+        timeout_phase_ = phase;
+    }
+
+    void session::cancel_timeout()
+    {
+        arm_timeout(timeout_phase::none);
+    }
+
+    std::chrono::milliseconds session::get_timeout(timeout_phase phase) const
+    {
+        switch (phase)
         {
-            std::cout << oss.str() << '\n';
+            case timeout_phase::handshake:
+                return timeouts_.handshake_;
+            case timeout_phase::idle:
+                return timeouts_.idle_;
+            case timeout_phase::header_read:
+                return timeouts_.header_read_;
+            case timeout_phase::content_read:
+                return timeouts_.content_read_;
+            case timeout_phase::none:
+                break;
         }
+        return std::chrono::milliseconds::zero();
+    }
+
+    void session::set_protocol_version(micro_tcp::protocol_version version)
+    {
+        protocol_version_ = version;
+        read_buffer_.set_protocol_version(version);
+        write_buffer_.set_protocol_version(version);
+    }
+
+    micro_tcp::optional_secure_stream::next_layer_type& session::socket()
+    {
+        return secure_stream_.next_layer();
+    }
+
+    bool session::is_alive()
+    {
+        return socket().is_open();
     }
 
 }
\ No newline at end of file
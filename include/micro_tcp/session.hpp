@@ -25,11 +25,20 @@
 #ifndef MICRO_TCP_SESSION_HPP
 #define MICRO_TCP_SESSION_HPP
 
-#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/ssl/stream.hpp>
-#include <boost/asio/strand.hpp>
+#include <micro_tcp/optional_secure_stream.hpp>
+#include <micro_tcp/optional_strand.hpp>
 #include <micro_tcp/request_handler.hpp>
 #include <micro_tcp/message.hpp>
+#include <micro_tcp/mapped_file.hpp>
+#include <micro_tcp/files.hpp>
+#include <micro_tcp/compression.hpp>
+#include <micro_tcp/timing_wheel.hpp>
+#include <micro_tcp/handler_memory.hpp>
+#include <chrono>
+#include <deque>
+#include <vector>
 
 namespace micro_tcp
 {
@@ -43,18 +52,19 @@ namespace micro_tcp
      *      (3) read message header >
      *      (4) read message contents >
      *      (5) handle request and define response >
-     *      (6) write message header (response) >
-     *      (7) write message contents (response) >
-     *      (8) go back to (2)
+     *      (6) write message header and contents (response) in a single write >
+     *      (7) go back to (2)
      * @li Client sequence:
      *      (1) secure handshake (as client) >
      *      (2) keep session alive (wait for send) >
-     *      (3) write message header (request) >
-     *      (4) write message contents (request) >
-     *      (5) read message header (response) >
-     *      (6) read message contents (response) >
-     *      (7) handle response >
-     *      (8) go back to (2)
+     *      (3) write message header and contents (request) in a single write >
+     *      (4) read message header (response) >
+     *      (5) read message contents (response) >
+     *      (6) handle response >
+     *      (7) go back to (2)
+     *
+     * The on_* hooks are virtual and are called through this base class, once per message read or written (see
+     * session::dispatch_read() and session::complete_write()).
      *
      * @see server_session
      * @see client_session
@@ -63,6 +73,59 @@ namespace micro_tcp
             public std::enable_shared_from_this<session>
     {
     public:
+        /**
+         * @brief Counters of the write path of all sessions. The average amount of messages per write is
+         * frames_ / writes_.
+         */
+        struct write_statistics
+        {
+            std::uint64_t writes_; /*!< Write operations started on a stream. */
+            std::uint64_t frames_; /*!< Messages written by these operations. */
+        };
+
+        /**
+         * @brief Secure handshakes of all sessions in one role. The resumption hit rate is
+         * resumed_ / (full_ + resumed_).
+         */
+        struct handshake_statistics
+        {
+            std::uint64_t full_; /*!< Handshakes that negotiated a new SSL/TLS session. */
+            std::uint64_t resumed_; /*!< Abbreviated handshakes that resumed a session ticket or cached session. */
+        };
+
+        /**
+         * @brief Deadlines of a session, enforced on the timing_wheel of its io_service. Zero disables a deadline.
+         */
+        struct timeouts
+        {
+            std::chrono::milliseconds handshake_; /*!< From the start of the secure handshake to its completion. */
+            std::chrono::milliseconds idle_; /*!< Waiting for the first byte of the next message. */
+            std::chrono::milliseconds header_read_; /*!< From the first byte of a header to the complete header. */
+            std::chrono::milliseconds content_read_; /*!< Without any content byte being received. */
+        };
+
+        /**
+         * @brief Messages up to this size (header and content) are linearized into a single buffer before writing.
+         * Equal to the maximum plaintext size of a single SSL/TLS record.
+         */
+        static constexpr std::size_t max_linearized_write_size_ = 16384;
+
+        /**
+         * @brief Byte budget of a single write. Queued linearizable messages are appended to the write buffer as
+         * long as they fit, so a burst of small messages is sealed in as few SSL/TLS records as possible.
+         */
+        static constexpr std::size_t max_coalesced_write_size_ = 65536;
+
+        /**
+         * @brief Size of the receive buffer which incoming bytes are read into before they are split into frames.
+         */
+        static constexpr std::size_t receive_buffer_size_ = 65536;
+
+        /**
+         * @brief Maximum nesting of read hooks called directly from buffered data.
+         */
+        static constexpr unsigned int max_read_dispatch_depth_ = 16;
+
         /**
          * @brief Non-copyable - delete copy constructor.
          */
@@ -76,12 +139,13 @@ namespace micro_tcp
         /**
          * @brief Default constructor. Wraps the raw socket in a secure (SSL/TLS) stream.
          *
-         * @param socket A reference to a socket. Passed on using move semantics with class member session::socket_
+         * @param socket A reference to a connected stream socket, TCP (boost::asio::ip::tcp::socket converts
+         * implicitly) or a Unix domain socket. Passed on using move semantics with class member session::socket_
          * as the final destination.
          * @param context A reference to a context object containing the secure (SSL/TLS) options, certificates,
          * verification mode and so on.
          */
-        explicit session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& context);
+        explicit session(boost::asio::generic::stream_protocol::socket socket, boost::asio::ssl::context& context);
 
         /**
          * @brief Default destructor. Virtual since it is a base class for server_session and client_session.
@@ -113,10 +177,91 @@ namespace micro_tcp
          */
         bool is_alive();
 
+        /**
+         * @brief Set the compression options for outgoing messages. MUST be called before session::start().
+         *
+         * @param options The compression options.
+         */
+        void set_compression_options(const micro_tcp::compression_options& options);
+
+        /**
+         * @brief Skip the strand for a session whose io_service is run by a single thread. MUST be called before
+         * session::start().
+         *
+         * @param single_threaded True if the io_service of the session is run by a single thread.
+         */
+        void set_single_threaded(bool single_threaded);
+
+        /**
+         * @brief Hold a lease (see io_manager::assignment) for the lifetime of the session.
+         *
+         * @param lease The lease.
+         */
+        void set_io_lease(std::shared_ptr<void> lease);
+
+        /**
+         * @brief Set the deadlines of the session. MUST be called before session::start(). By default all deadlines
+         * are disabled.
+         *
+         * @param timeouts The deadlines.
+         */
+        void set_timeouts(const timeouts& timeouts);
+
+        /**
+         * @brief Set the largest content length accepted from the peer. MUST be called before session::start(). A
+         * message header claiming more content is rejected and the session is stopped. By default
+         * message::default_max_content_length_.
+         *
+         * @param max_content_length The largest content length in bytes.
+         */
+        void set_max_content_length(std::uint64_t max_content_length);
+
+        /**
+         * @brief Set the transport of the session. MUST be called before session::start(). By default messages are
+         * sent over SSL/TLS. With transport::plain the secure handshake and shutdown are skipped.
+         *
+         * @param transport The transport.
+         */
+        void set_transport(micro_tcp::transport transport);
+
+        /**
+         * @brief
+         *
+         * @return The transport of the session.
+         */
+        micro_tcp::transport get_transport() const;
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the write counters of all sessions.
+         */
+        static write_statistics get_write_statistics();
+
+        /**
+         * @brief
+         *
+         * @param type The role of the sessions, client or server.
+         * @return A snapshot of the handshake counters of all sessions in that role.
+         */
+        static handshake_statistics get_handshake_statistics(boost::asio::ssl::stream_base::handshake_type type);
+
     protected:
+        /**
+         * @brief The deadline currently armed on session::timeout_timer_.
+         */
+        enum class timeout_phase
+        {
+            none,
+            handshake,
+            idle,
+            header_read,
+            content_read
+        };
+
         /**
          * @brief Attempt to asynchronously perform a secure (SSL/TLS) handshake as either a client or
-         * server on the stream.
+         * server on the stream. With transport::plain the handshake completes right away.
          *
          * @post If successful, the most derived (server_session or client_session) session::on_secure_handshake()
          * is called.
@@ -136,15 +281,20 @@ namespace micro_tcp
         virtual void on_secure_handshake() = 0;
 
         /**
-         * @brief Start an asynchronous operation on the stream to read an X amount of bytes where X equals
-         * read_buffer_.header_buffer_.size(). By default: message::default_header_length(). The buffer size MUST
-         * be set in message::prepare_header_buffer_read().
+         * @brief Fill read_buffer_.header_buffer_ from byte [offset] up to read_buffer_.header_buffer_.size(). By
+         * default: message::default_header_length(). The buffer size MUST be set in message::prepare_header_buffer_read().
          *
-         * @post If successful, the header has been written from the stream into the read_buffer_.header_buffer_
-         * and the most derived (server_session or client_session) session::on_read_header() is called.
+         * The header is taken from the receive buffer when enough bytes are buffered, without touching the stream.
+         * Otherwise an asynchronous read is started that pulls as many bytes as are available (up to
+         * session::receive_buffer_size_), so pipelined messages are decoded from a single read.
+         *
+         * @post If successful, the header has been copied into the read_buffer_.header_buffer_ and the most derived
+         * (server_session or client_session) session::on_read_header() is called.
          * @post If failed, the session will be closed.
+         *
+         * @param offset The amount of header bytes already present in read_buffer_.header_buffer_.
          */
-        void do_read_header();
+        void do_read_header(std::size_t offset = 0);
 
         /**
          * @brief Called on a successful (header) read after session::do_read_header().
@@ -155,15 +305,32 @@ namespace micro_tcp
         virtual void on_read_header() = 0;
 
         /**
-         * @brief Start an asynchronous operation on the stream to read an X amount of bytes where X equals
-         * read_buffer_.content_buffer_.size(). The buffer size MUST be set in message::prepare_content_buffer_read().
+         * @brief Fill read_buffer_.content_buffer_ up to read_buffer_.content_buffer_.size(). The buffer size MUST be
+         * set in message::prepare_content_buffer_read().
          *
-         * @post If successful, the content has been written from the stream into the read_buffer_.content_buffer_ and
-         * the most derived (server_session or client_session) session::on_read_content() is called.
+         * Buffered bytes are consumed first. A remainder of at least session::receive_buffer_size_ bytes is read
+         * directly into the content buffer, smaller remainders go through the receive buffer.
+         *
+         * @post If successful, the content has been copied into the read_buffer_.content_buffer_ and the most derived
+         * (server_session or client_session) session::on_read_content() is called.
          * @post If failed, the session will be closed.
          */
         void do_read_content();
 
+        /**
+         * @brief Stream [content_length] content bytes into session::content_sink_ instead of
+         * read_buffer_.content_buffer_. The bytes are taken from the receive buffer and written to the sink one
+         * receive (at most session::receive_buffer_size_ bytes) at a time, so memory stays bounded regardless of
+         * the content length.
+         *
+         * @post If successful, the sink has been closed and the most derived (server_session or client_session)
+         * session::on_read_content() is called.
+         * @post If failed, the session will be closed.
+         *
+         * @param content_length The content length announced in the header.
+         */
+        void do_read_content_to_sink(std::uint64_t content_length);
+
         /**
          * @brief Called on a successful (content) read after session::do_read_content().
          *
@@ -173,41 +340,89 @@ namespace micro_tcp
         virtual void on_read_content() = 0;
 
         /**
-         * @brief Start an asynchronous operation on the stream to write an X amount of bytes where X equals
-         * write_buffer_.header_buffer_.size(). The buffer contents (and size) MUST be set in message::prepare_header_buffer_write().
+         * @brief Start a single asynchronous operation on the stream that writes write_buffer_.header_buffer_
+         * followed by write_buffer_.content_buffer_. The header buffer contents (and size) MUST be set in
+         * message::prepare_header_buffer_write().
          *
-         * @post If successful, the buffer contents (header) have been written to the stream and the most derived
-         * (server_session or client_session) session::on_write_header() is called.
+         * A message of at most session::max_linearized_write_size_ bytes is first copied into one contiguous buffer,
+         * so the secure stream seals it in a single SSL/TLS record and a single send. Queued messages are appended
+         * to that buffer by session::coalesce_write_queue(). Larger messages are written as a sequence of two
+         * buffers. Content backed by a file (message::content_file_) is continued in session::do_write_content_file().
+         *
+         * @post If successful, the header and content have been written to the stream and the most derived
+         * (server_session or client_session) session::on_write_header() and session::on_write_content() are
+         * called, in that order, for every message of the write.
          * @post If failed, the session will be closed.
          */
-        void do_write_header();
+        void do_write_message();
 
         /**
-         * @brief Called on a successful (header) write after session::do_write_header().
+         * @brief Queue a message for writing. Queued messages are written back-to-back in FIFO order, without
+         * waiting for any response in between. MUST be called from within the strand.
          *
-         * @see server_session::on_write_content()
-         * @see client_session::on_write_content()
+         * @param message The message to write. Its protocol version is set to the session's protocol version.
          */
-        virtual void on_write_header() = 0;
+        void enqueue_write(micro_tcp::message message);
+
+        /**
+         * @brief Move the next message of the write queue into write_buffer_, compress its content if the
+         * compression options and the peer allow it and write it with session::do_write_message(). Does nothing if
+         * the queue is empty.
+         */
+        void do_write_next();
+
+        /**
+         * @brief Set the protocol version of an outgoing message, compress its content if the compression options
+         * and the peer allow it and prepare its header.
+         *
+         * @param message The message to prepare.
+         * @return False if its content is too large for a header of the session's protocol version.
+         */
+        bool prepare_write(micro_tcp::message& message);
+
+        /**
+         * @brief Move queued messages into session::write_batch_ and append them to write_linear_buffer_ for as long
+         * as each is linearizable and the buffer stays within session::max_coalesced_write_size_. Messages with a
+         * content file end the batch.
+         */
+        void coalesce_write_queue();
 
         /**
-         * @brief Start an asynchronous operation on the stream to write an X amount of bytes where X equals
-         * write_buffer_.content_buffer_.size(). The buffer contents (and size) MUST be set in message::prepare_content_buffer_write().
+         * @brief Write the next window of write_buffer_.content_file_, starting at session::write_file_offset_. The
+         * header is written along with the first window. Each window is unmapped once it is on the stream.
          *
-         * @post If successful, the buffer contents (content) have been written to the stream and the most derived
-         * (server_session or client_session) session::on_write_content() is called.
+         * @post If the last window has been written, the content_file_ is released and session::on_write_content()
+         * is called.
          * @post If failed, the session will be closed.
+         *
+         * @param with_header Write write_buffer_.header_buffer_ in front of the window.
+         */
+        void do_write_content_file(bool with_header);
+
+        /**
+         * @brief Called on a successful write after session::do_write_message(), once the header is on the stream.
+         *
+         * @see server_session::on_write_header()
+         * @see client_session::on_write_header()
          */
-        void do_write_content();
+        virtual void on_write_header() = 0;
 
         /**
-         * @brief Called on a successful (content) write after session::do_write_content().
+         * @brief Called on a successful write after session::do_write_message() and session::on_write_header(),
+         * once the content is on the stream.
          *
          * @see server_session::on_write_content()
          * @see client_session::on_write_content()
          */
         virtual void on_write_content() = 0;
 
+        /**
+         * @brief Call session::on_write_content() for the message that has just been written, then
+         * session::on_write_header() and session::on_write_content() for every message coalesced with it, and
+         * continue with the next queued message, if any.
+         */
+        void complete_write();
+
         /**
          * @brief Asynchronously shut down the (SSL/TLS) protocol on the stream. Close the socket afterwards
          * by calling session::close_socket(). Quotes (1) and (2) in the remarks section describe the rationale
@@ -277,25 +492,128 @@ namespace micro_tcp
          */
         virtual void on_close_socket() = 0;
 
+        /**
+         * @brief Called from within the strand when the deadline of session::timeout_phase_ has passed. Closes the
+         * socket by default, without a secure shutdown.
+         */
+        virtual void on_timeout();
+
+        /**
+         * @brief Arm the deadline of a phase, unless it is disabled, replacing the current deadline.
+         *
+         * @param phase The phase.
+         */
+        void arm_timeout(timeout_phase phase);
+
+        /**
+         * @brief Disarm the current deadline.
+         */
+        void cancel_timeout();
+
+        /**
+         * @brief
+         *
+         * @param phase The phase.
+         * @return The deadline of a phase, zero if disabled.
+         */
+        std::chrono::milliseconds get_timeout(timeout_phase phase) const;
+
         /**
          * @brief Convenience function to get a reference to the underlying transport.
          *
          * @return A reference to the next layer in the stack of stream layers. In this case, the underlying
-         * transport (boost::asio::ip::tcp::socket).
+         * transport (a TCP or Unix domain stream socket).
          */
-        boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::next_layer_type& socket();
+        micro_tcp::optional_secure_stream::next_layer_type& socket();
 
         /**
-         * Just used for debugging.
-         * Todo: delete this function.
+         * @brief Start an asynchronous read of as many bytes as are available into the free space of the receive
+         * buffer, then continue with session::continue_read_header() or session::continue_read_content(). Arms the
+         * idle deadline if no byte of the next header has been received yet, the header deadline once, or the content
+         * deadline on every receive.
+         *
+         * @param continuation The read step to continue with once bytes have been received.
+         */
+        void do_receive(void (session::*continuation)());
+
+        /**
+         * @brief Complete the header from the receive buffer or receive more bytes.
+         */
+        void continue_read_header();
+
+        /**
+         * @brief Complete the content from the receive buffer or receive more bytes.
+         */
+        void continue_read_content();
+
+        /**
+         * @brief Decompress read_buffer_ if needed, remember the codecs advertised by the peer and call
+         * session::on_read_content().
+         */
+        void complete_read_content();
+
+        /**
+         * @brief Write the receive buffer to the content sink or receive more bytes.
+         */
+        void continue_read_content_to_sink();
+
+        /**
+         * @brief Call a read hook directly, unless the hooks are already nested session::max_read_dispatch_depth_
+         * times, in which case it is posted to the strand. Frames decoded from a single receive would otherwise
+         * recurse once per frame.
+         *
+         * @param hook The read hook to call.
+         */
+        void dispatch_read(void (session::*hook)());
+
+        /**
+         * @brief Wrap the completion handler of an operation on the stream in the strand. The operation state is
+         * allocated from session::handler_memory_.
+         *
+         * @param handler The handler.
+         * @return The wrapped handler.
+         */
+        template<typename Handler>
+        auto wrap_handler(Handler&& handler)
+        {
+            return io_strand_.wrap(micro_tcp::make_allocating_handler(handler_memory_, std::forward<Handler>(handler)));
+        }
+
+        /**
+         * @brief Set the protocol version used for all incoming and outgoing messages of this session.
+         *
+         * @param version The protocol version.
          */
-        void debug(const std::string& msg, const std::string& ec = "");
+        void set_protocol_version(micro_tcp::protocol_version version);
 
         micro_tcp::message read_buffer_; /*!< Buffer used for incoming messages. */
         micro_tcp::message write_buffer_; /*!< Buffer used for outgoing messages. */
-        boost::asio::ip::tcp::socket socket_;
-        boost::asio::ssl::stream<boost::asio::ip::tcp::socket&> secure_stream_;
-        boost::asio::io_service::strand io_strand_;
+        micro_tcp::message::buffer_type write_linear_buffer_; /*!< Header and content of small outgoing messages. */
+        boost::asio::generic::stream_protocol::socket socket_;
+        micro_tcp::optional_secure_stream secure_stream_; /*!< SSL/TLS stream, unless the transport is plain. */
+        micro_tcp::optional_strand io_strand_; /*!< Serializes the handlers, unless the session is single threaded. */
+        micro_tcp::protocol_version protocol_version_; /*!< Protocol version spoken on this session. */
+        micro_tcp::message::buffer_type receive_buffer_; /*!< Received bytes not yet consumed by a read. */
+        std::size_t receive_begin_; /*!< Offset of the first unconsumed byte in receive_buffer_. */
+        std::size_t receive_end_; /*!< Offset past the last received byte in receive_buffer_. */
+        std::size_t read_offset_; /*!< Bytes of the header or content currently being read that are filled. */
+        unsigned int read_dispatch_depth_; /*!< Nesting of read hooks called from session::dispatch_read(). */
+        std::unique_ptr<micro_tcp::mapped_file::window_type> write_file_window_; /*!< Window of a content file being written. */
+        std::uint64_t write_file_offset_; /*!< Offset of the next window of a content file. */
+        std::unique_ptr<micro_tcp::file_sink> content_sink_; /*!< Sink for incoming content, if any. */
+        std::uint64_t content_sink_remaining_; /*!< Content bytes still to be written to the content sink. */
+        std::deque<micro_tcp::message> write_queue_; /*!< Messages waiting for the current write to complete. */
+        bool write_in_progress_; /*!< True while write_buffer_ is being written. */
+        std::vector<micro_tcp::message> write_batch_; /*!< Messages written along with write_buffer_. */
+        micro_tcp::compression_options compression_options_; /*!< Compression of outgoing messages. */
+        std::uint16_t peer_codecs_; /*!< Compression codecs advertised by the peer in its last v2 header. */
+        micro_tcp::message::buffer_type compression_buffer_; /*!< Scratch buffer for (de)compression. */
+        std::shared_ptr<void> io_lease_; /*!< Counts the session towards the load of its io_service. */
+        micro_tcp::timing_wheel::timer timeout_timer_; /*!< Deadline of the current phase. */
+        timeouts timeouts_;
+        timeout_phase timeout_phase_;
+        std::uint64_t max_content_length_; /*!< Largest content length accepted from the peer. */
+        micro_tcp::handler_memory handler_memory_; /*!< Operation state of the reads and writes on the stream. */
     };
 
     typedef std::shared_ptr<session> session_ptr;
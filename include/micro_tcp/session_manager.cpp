@@ -0,0 +1,131 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/session_manager.hpp>
+#include <micro_tcp/server_session.hpp>
+#include <functional>
+
+namespace micro_tcp
+{
+    /*static*/constexpr std::size_t session_manager::shard_count_;
+    /*static*/constexpr std::chrono::milliseconds session_manager::close_timeout_;
+
+    session_manager::session_manager() :
+            session_count_(0)
+    {
+        /*...*/
+    }
+
+    void session_manager::add(const std::shared_ptr<micro_tcp::server_session>& session)
+    {
+        auto& shard = get_shard(session.get());
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            shard.sessions_.emplace(session.get(), session);
+        }
+        session_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void session_manager::remove(const micro_tcp::server_session* session)
+    {
+        auto& shard = get_shard(session);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            if (shard.sessions_.erase(session) == 0)
+            {
+                return;
+            }
+        }
+        if (session_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(empty_mutex_);
+            empty_condition_.notify_all();
+        }
+    }
+
+    std::size_t session_manager::get_session_count() const
+    {
+        return session_count_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t session_manager::drain(std::chrono::milliseconds timeout)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (const auto& session : get_sessions())
+        {
+            session->drain();
+        }
+        if (wait_until_empty(deadline))
+        {
+            return 0;
+        }
+        auto sessions = get_sessions();
+        const auto remaining = sessions.size();
+        for (const auto& session : sessions)
+        {
+            session->close();
+        }
+        sessions.clear(); //Closed sessions can only be destroyed (and unregistered) once nothing holds them.
+        wait_until_empty(std::chrono::steady_clock::now() + close_timeout_);
+        return remaining;
+    }
+
+    session_manager::shard& session_manager::get_shard(const micro_tcp::server_session* session)
+    {
+        return shards_[std::hash<const micro_tcp::server_session*>()(session) / alignof(std::max_align_t) % shard_count_];
+    }
+
+    std::vector<std::shared_ptr<micro_tcp::server_session>> session_manager::get_sessions()
+    {
+        std::vector<std::weak_ptr<micro_tcp::server_session>> registered;
+        registered.reserve(get_session_count());
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            for (const auto& entry : shard.sessions_)
+            {
+                registered.push_back(entry.second);
+            }
+        }
+        std::vector<std::shared_ptr<micro_tcp::server_session>> sessions;
+        sessions.reserve(registered.size());
+        for (const auto& session : registered)
+        {
+            if (auto locked = session.lock())
+            {
+                sessions.push_back(std::move(locked));
+            }
+        }
+        return sessions;
+    }
+
+    bool session_manager::wait_until_empty(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(empty_mutex_);
+        return empty_condition_.wait_until(lock, deadline, [this]()
+        {
+            return session_count_.load(std::memory_order_acquire) == 0;
+        });
+    }
+}
@@ -0,0 +1,153 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_SESSION_MANAGER_HPP
+#define MICRO_TCP_SESSION_MANAGER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace micro_tcp
+{
+    class server_session;
+
+    /**
+     * @brief Registry of the live sessions of a server.
+     *
+     * Sessions are spread over session_manager::shard_count_ shards by address, each with a lock of its own, so
+     * sessions accepted and destroyed on different io threads rarely contend. The amount of live sessions is kept in
+     * a single counter.
+     *
+     * session_manager::drain() stops the sessions in two phases: every session first finishes the requests it has
+     * read and then shuts down, sessions still alive at the deadline are closed. Both phases are dispatched to the
+     * strand of each session, so they run in parallel on all io threads.
+     */
+    class session_manager
+    {
+    public:
+        /**
+         * @brief Amount of shards of the registry.
+         */
+        static constexpr std::size_t shard_count_ = 64;
+
+        /**
+         * @brief How long session_manager::drain() waits for the closed sessions to be destroyed.
+         */
+        static constexpr std::chrono::milliseconds close_timeout_{1000};
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        session_manager(const session_manager&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        session_manager& operator=(const session_manager&) = delete;
+
+        /**
+         * @brief Default constructor.
+         */
+        session_manager();
+
+        /**
+         * @brief Register a session. The session removes itself when destroyed (see
+         * server_session::set_session_manager()).
+         *
+         * @param session The session.
+         */
+        void add(const std::shared_ptr<micro_tcp::server_session>& session);
+
+        /**
+         * @brief Unregister a session.
+         *
+         * @param session The session.
+         */
+        void remove(const micro_tcp::server_session* session);
+
+        /**
+         * @brief
+         *
+         * @return The amount of live sessions.
+         */
+        std::size_t get_session_count() const;
+
+        /**
+         * @brief Let every session finish the requests it has read and shut down. Sessions still alive after
+         * [timeout] are closed. Blocks until all sessions are destroyed or session_manager::close_timeout_ has passed
+         * after closing them. MUST NOT be called from an io thread, the io threads MUST keep running.
+         *
+         * @param timeout The time given to the sessions to finish their requests.
+         * @return The amount of sessions that had to be closed.
+         */
+        std::size_t drain(std::chrono::milliseconds timeout);
+
+    private:
+        /**
+         * @brief Sessions registered in a single shard.
+         */
+        struct shard
+        {
+            std::mutex mutex_;
+            std::unordered_map<const micro_tcp::server_session*, std::weak_ptr<micro_tcp::server_session>> sessions_;
+        };
+
+        /**
+         * @brief
+         *
+         * @param session The session.
+         * @return The shard of a session.
+         */
+        shard& get_shard(const micro_tcp::server_session* session);
+
+        /**
+         * @brief Take a snapshot of the live sessions. The sessions are locked outside of the shard locks, so a
+         * session released by the snapshot may unregister itself.
+         *
+         * @return The live sessions.
+         */
+        std::vector<std::shared_ptr<micro_tcp::server_session>> get_sessions();
+
+        /**
+         * @brief Wait until all sessions are destroyed.
+         *
+         * @param deadline The time to give up waiting.
+         * @return True if all sessions are destroyed.
+         */
+        bool wait_until_empty(std::chrono::steady_clock::time_point deadline);
+
+        std::array<shard, shard_count_> shards_;
+        std::atomic<std::size_t> session_count_;
+        std::mutex empty_mutex_;
+        std::condition_variable empty_condition_; /*!< Notified when the last session is unregistered. */
+    };
+}
+
+#endif
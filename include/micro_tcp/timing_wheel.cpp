@@ -0,0 +1,271 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/timing_wheel.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace micro_tcp
+{
+    /*static*/constexpr std::chrono::milliseconds timing_wheel::tick_;
+    /*static*/constexpr std::size_t timing_wheel::inner_slots_;
+    /*static*/constexpr std::size_t timing_wheel::outer_slots_;
+    /*static*/constexpr std::size_t timing_wheel::max_shards_;
+    /*static*/boost::asio::io_service::id timing_wheel::id;
+
+    timing_wheel::timer::timer(boost::asio::io_service& io_service) :
+            shard_(boost::asio::use_service<timing_wheel>(io_service).next_shard()),
+            previous_(nullptr),
+            next_(nullptr),
+            slot_(nullptr),
+            expiry_(0),
+            state_(state::idle)
+    {
+        /*...*/
+    }
+
+    timing_wheel::timer::~timer()
+    {
+        cancel();
+    }
+
+    void timing_wheel::timer::set_handler(handler_type handler)
+    {
+        std::lock_guard<std::mutex> lock(shard_.mutex_);
+        handler_ = std::move(handler);
+    }
+
+    void timing_wheel::timer::arm(std::chrono::milliseconds duration)
+    {
+        const auto due = std::chrono::steady_clock::now() - shard_.origin_ +
+                         std::max(duration, std::chrono::milliseconds::zero());
+        const auto due_tick = static_cast<std::uint64_t>((due + tick_ - std::chrono::steady_clock::duration(1)) / tick_);
+        std::lock_guard<std::mutex> lock(shard_.mutex_);
+        if (state_ == state::armed)
+        {
+            shard_.unlink(*this);
+        }
+        else
+        {
+            if (shard_.armed_count_ == 0)
+            {
+                // The wheel is empty, skip the ticks that passed without timers.
+                shard_.current_tick_ = std::max(shard_.current_tick_, shard_.now_tick());
+            }
+            ++shard_.armed_count_;
+        }
+        expiry_ = std::max(shard_.current_tick_ + 1, due_tick);
+        state_ = state::armed;
+        shard_.link(*this);
+        shard_.schedule_tick();
+    }
+
+    void timing_wheel::timer::cancel()
+    {
+        std::lock_guard<std::mutex> lock(shard_.mutex_);
+        if (state_ == state::armed)
+        {
+            shard_.unlink(*this);
+            --shard_.armed_count_;
+        }
+        state_ = state::idle;
+    }
+
+    bool timing_wheel::timer::has_expired() const
+    {
+        std::lock_guard<std::mutex> lock(shard_.mutex_);
+        return state_ == state::expired;
+    }
+
+    timing_wheel::timing_wheel(boost::asio::io_service& io_service) :
+            timing_wheel(io_service, std::thread::hardware_concurrency())
+    {
+        /*...*/
+    }
+
+    timing_wheel::timing_wheel(boost::asio::io_service& io_service, std::size_t shard_count) :
+            boost::asio::io_service::service(io_service),
+            next_shard_(0)
+    {
+        shard_count = std::min(std::max<std::size_t>(shard_count, 1), max_shards_);
+        shards_.reserve(shard_count);
+        for (std::size_t index = 0; index < shard_count; ++index)
+        {
+            shards_.push_back(std::make_unique<shard>(io_service));
+        }
+    }
+
+    timing_wheel::~timing_wheel() = default;
+
+    void timing_wheel::shutdown_service()
+    {
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex_);
+            shard->shut_down_ = true;
+            boost::system::error_code ec;
+            shard->tick_timer_.cancel(ec);
+        }
+    }
+
+    std::size_t timing_wheel::get_armed_count() const
+    {
+        std::size_t armed_count = 0;
+        for (const auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex_);
+            armed_count += shard->armed_count_;
+        }
+        return armed_count;
+    }
+
+    std::size_t timing_wheel::get_shard_count() const
+    {
+        return shards_.size();
+    }
+
+    timing_wheel::shard& timing_wheel::next_shard()
+    {
+        return *shards_[next_shard_.fetch_add(1, std::memory_order_relaxed) % shards_.size()];
+    }
+
+    timing_wheel::shard::shard(boost::asio::io_service& io_service) :
+            tick_timer_(io_service),
+            origin_(std::chrono::steady_clock::now()),
+            current_tick_(0),
+            armed_count_(0),
+            ticking_(false),
+            shut_down_(false)
+    {
+        inner_.fill(nullptr);
+        outer_.fill(nullptr);
+    }
+
+    void timing_wheel::shard::link(timer& timer)
+    {
+        timing_wheel::timer** slot;
+        if (timer.expiry_ - current_tick_ < inner_slots_)
+        {
+            slot = &inner_[timer.expiry_ % inner_slots_];
+        }
+        else
+        {
+            // Rounds beyond the outer wheel wait in its last round and are placed again when it is cascaded.
+            const auto round = std::min(timer.expiry_ / inner_slots_, current_tick_ / inner_slots_ + outer_slots_ - 1);
+            slot = &outer_[round % outer_slots_];
+        }
+        timer.slot_ = slot;
+        timer.previous_ = nullptr;
+        timer.next_ = *slot;
+        if (*slot)
+        {
+            (*slot)->previous_ = &timer;
+        }
+        *slot = &timer;
+    }
+
+    void timing_wheel::shard::unlink(timer& timer)
+    {
+        if (timer.previous_)
+        {
+            timer.previous_->next_ = timer.next_;
+        }
+        else
+        {
+            *timer.slot_ = timer.next_;
+        }
+        if (timer.next_)
+        {
+            timer.next_->previous_ = timer.previous_;
+        }
+        timer.previous_ = timer.next_ = nullptr;
+        timer.slot_ = nullptr;
+    }
+
+    std::uint64_t timing_wheel::shard::now_tick() const
+    {
+        return static_cast<std::uint64_t>((std::chrono::steady_clock::now() - origin_) / tick_);
+    }
+
+    void timing_wheel::shard::schedule_tick()
+    {
+        if (ticking_ || shut_down_ || armed_count_ == 0)
+        {
+            return;
+        }
+        ticking_ = true;
+        tick_timer_.expires_at(origin_ + tick_ * static_cast<std::chrono::milliseconds::rep>(current_tick_ + 1));
+        tick_timer_.async_wait([this](const boost::system::error_code& ec)
+        {
+            on_tick(ec);
+        });
+    }
+
+    void timing_wheel::shard::on_tick(const boost::system::error_code& ec)
+    {
+        std::vector<timer::handler_type> handlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ticking_ = false;
+            if (ec == boost::asio::error::operation_aborted || shut_down_)
+            {
+                return;
+            }
+            const auto target = now_tick();
+            while (current_tick_ < target && armed_count_ != 0)
+            {
+                ++current_tick_;
+                if (current_tick_ % inner_slots_ == 0)
+                {
+                    auto& round = outer_[(current_tick_ / inner_slots_) % outer_slots_];
+                    auto cascaded = round;
+                    round = nullptr;
+                    while (cascaded)
+                    {
+                        auto& timer = *cascaded;
+                        cascaded = timer.next_;
+                        link(timer);
+                    }
+                }
+                auto& slot = inner_[current_tick_ % inner_slots_];
+                while (slot)
+                {
+                    auto& timer = *slot;
+                    unlink(timer);
+                    timer.state_ = timer::state::expired;
+                    --armed_count_;
+                    if (timer.handler_)
+                    {
+                        handlers.push_back(timer.handler_);
+                    }
+                }
+            }
+            schedule_tick();
+        }
+        for (const auto& handler : handlers)
+        {
+            handler();
+        }
+    }
+}
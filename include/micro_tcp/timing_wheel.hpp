@@ -0,0 +1,272 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_TIMING_WHEEL_HPP
+#define MICRO_TCP_TIMING_WHEEL_HPP
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Hierarchical timing wheels, one set per io_service (an io_service service, see
+     * boost::asio::use_service()), for the timeouts of many sessions at once.
+     *
+     * Time advances in ticks of timing_wheel::tick_. Timers expiring within timing_wheel::inner_slots_ ticks are
+     * kept in the slot of their expiry tick on the inner wheel, later timers in the slot of their round on the outer
+     * wheel, which is cascaded into the inner wheel once that round starts. Timers even further away are parked on
+     * the last round of the outer wheel and placed again when it is cascaded. Every slot is an intrusive list, so
+     * arming and cancelling a timer is O(1) and never allocates.
+     *
+     * The timers of an io_service are spread round-robin over several wheels (shards), each with its own lock and
+     * steady_timer. A wheel per thread would need no lock at all, but in the shared io_service model a session's
+     * handlers run on any thread of the io_service, so its timer is armed and cancelled from several threads and
+     * could not stay on the wheel of one thread. Sharding instead keeps the many I/O threads of a shared io_service
+     * from contending on a single lock. An io_service run by a single thread (io_manager's io_service-per-thread
+     * model) registers a single wheel, whose lock is then never contended.
+     *
+     * A wheel is driven by its steady_timer only while timers are armed on it. Expired timers call their handler from
+     * the io_service, after the wheel lock is released.
+     */
+    class timing_wheel :
+            public boost::asio::io_service::service
+    {
+        struct shard;
+
+    public:
+        /**
+         * @brief Resolution of the wheel. Timers never expire early and at most one tick late.
+         */
+        static constexpr std::chrono::milliseconds tick_{100};
+
+        /**
+         * @brief Amount of slots (ticks) of the inner wheel.
+         */
+        static constexpr std::size_t inner_slots_ = 256;
+
+        /**
+         * @brief Amount of slots (rounds of the inner wheel) of the outer wheel.
+         */
+        static constexpr std::size_t outer_slots_ = 64;
+
+        /**
+         * @brief Most wheels (shards) per io_service.
+         */
+        static constexpr std::size_t max_shards_ = 16;
+
+        /**
+         * @brief A timer on a wheel of an io_service. Not thread-safe itself: arm and cancel a timer from a single
+         * strand.
+         */
+        class timer
+        {
+        public:
+            typedef std::function<void()> handler_type;
+
+            /**
+             * @brief Non-copyable - delete copy constructor.
+             */
+            timer(const timer&) = delete;
+
+            /**
+             * @brief Non-copyable - delete assignment operator.
+             */
+            timer& operator=(const timer&) = delete;
+
+            /**
+             * @brief
+             *
+             * @param io_service The io_service on one of whose wheels the timer is put.
+             */
+            explicit timer(boost::asio::io_service& io_service);
+
+            /**
+             * @brief Cancels the timer.
+             */
+            ~timer();
+
+            /**
+             * @brief Set the handler called when the timer expires. Called from any thread of the io_service, the
+             * handler MUST check timer::has_expired() on the strand of the timer's owner, since the timer may have
+             * been armed or cancelled again in the meantime.
+             *
+             * @param handler The handler.
+             */
+            void set_handler(handler_type handler);
+
+            /**
+             * @brief Arm the timer, replacing an earlier expiry.
+             *
+             * @param duration Time until the timer expires, rounded up to the next tick.
+             */
+            void arm(std::chrono::milliseconds duration);
+
+            /**
+             * @brief Disarm the timer and clear an expiry.
+             */
+            void cancel();
+
+            /**
+             * @brief
+             *
+             * @return True if the timer has expired since it was last armed.
+             */
+            bool has_expired() const;
+
+        private:
+            friend class timing_wheel;
+            friend struct timing_wheel::shard;
+
+            enum class state
+            {
+                idle,
+                armed,
+                expired
+            };
+
+            shard& shard_;
+            handler_type handler_;
+            timer *previous_; /*!< Slot list, guarded by the wheel lock. */
+            timer *next_; /*!< Slot list, guarded by the wheel lock. */
+            timer **slot_; /*!< Head of the slot list the timer is in, guarded by the wheel lock. */
+            std::uint64_t expiry_; /*!< Expiry tick, guarded by the wheel lock. */
+            state state_; /*!< Guarded by the wheel lock. */
+        };
+
+        static boost::asio::io_service::id id;
+
+        /**
+         * @brief Create one wheel per hardware thread, at most timing_wheel::max_shards_. Used by
+         * boost::asio::use_service().
+         *
+         * @param io_service The io_service owning the wheels.
+         */
+        explicit timing_wheel(boost::asio::io_service& io_service);
+
+        /**
+         * @brief Register with boost::asio::add_service() before the first timer to choose the amount of wheels, e.g.
+         * 1 for an io_service that is run by a single thread.
+         *
+         * @param io_service The io_service owning the wheels.
+         * @param shard_count The amount of wheels, at least 1 and at most timing_wheel::max_shards_.
+         */
+        timing_wheel(boost::asio::io_service& io_service, std::size_t shard_count);
+
+        /**
+         * @brief Default destructor.
+         */
+        ~timing_wheel() override;
+
+        /**
+         * @brief Stop driving the wheels.
+         */
+        void shutdown_service() override;
+
+        /**
+         * @brief
+         *
+         * @return The amount of armed timers.
+         */
+        std::size_t get_armed_count() const;
+
+        /**
+         * @brief
+         *
+         * @return The amount of wheels (shards).
+         */
+        std::size_t get_shard_count() const;
+
+    private:
+        /**
+         * @brief A single wheel with its own lock and steady_timer.
+         */
+        struct shard
+        {
+            explicit shard(boost::asio::io_service& io_service);
+
+            /**
+             * @brief Put an armed timer in the slot of its expiry tick or round. Called with the lock held.
+             *
+             * @param timer The timer.
+             */
+            void link(timer& timer);
+
+            /**
+             * @brief Take a timer out of its slot. Called with the lock held.
+             *
+             * @param timer The timer.
+             */
+            void unlink(timer& timer);
+
+            /**
+             * @brief
+             *
+             * @return The tick of the current time.
+             */
+            std::uint64_t now_tick() const;
+
+            /**
+             * @brief Start the steady_timer for the next tick. Called with the lock held.
+             */
+            void schedule_tick();
+
+            /**
+             * @brief Advance the wheel up to the current time and call the handlers of the expired timers.
+             *
+             * @param ec The result of the steady_timer wait.
+             */
+            void on_tick(const boost::system::error_code& ec);
+
+            mutable std::mutex mutex_;
+            boost::asio::steady_timer tick_timer_;
+            std::chrono::steady_clock::time_point origin_; /*!< Time of tick 0. */
+            std::uint64_t current_tick_; /*!< Last tick processed. */
+            std::array<timer*, inner_slots_> inner_;
+            std::array<timer*, outer_slots_> outer_;
+            std::size_t armed_count_;
+            bool ticking_; /*!< True while a wait of tick_timer_ is outstanding. */
+            bool shut_down_;
+        };
+
+        /**
+         * @brief
+         *
+         * @return The wheel of the next new timer, round-robin.
+         */
+        shard& next_shard();
+
+        std::vector<std::unique_ptr<shard>> shards_;
+        std::atomic<std::size_t> next_shard_;
+    };
+}
+
+#endif
@@ -0,0 +1,268 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/tls_resumption.hpp>
+#include <micro_tcp/logger.hpp>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace micro_tcp
+{
+    namespace
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        typedef EVP_MAC_CTX mac_context;
+#else
+        typedef HMAC_CTX mac_context;
+#endif
+
+        struct ticket_key
+        {
+            unsigned char name_[16]; /*!< Sent in the ticket to find the key again. */
+            unsigned char cipher_key_[32]; /*!< AES-256-CBC key of the ticket. */
+            unsigned char mac_key_[32]; /*!< HMAC-SHA256 key of the ticket. */
+            std::chrono::steady_clock::time_point created_;
+        };
+
+        /**
+         * @brief The current and the previous ticket key of a context. Owned by the context through its ex data.
+         */
+        class ticket_key_ring
+        {
+        public:
+            explicit ticket_key_ring(std::chrono::seconds lifetime) :
+                    lifetime_(lifetime),
+                    has_previous_(false)
+            {
+                /*...*/
+            }
+
+            bool initialize()
+            {
+                return generate(keys_[0]);
+            }
+
+            /**
+             * @brief The key to issue a ticket with, rotated when it has been in use for ticket_key_ring::lifetime_.
+             */
+            bool get_current(ticket_key& key)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (std::chrono::steady_clock::now() - keys_[0].created_ >= lifetime_)
+                {
+                    ticket_key next;
+                    if (!generate(next))
+                    {
+                        return false;
+                    }
+                    keys_[1] = keys_[0];
+                    keys_[0] = next;
+                    has_previous_ = true;
+                    MICRO_TCP_LOG_INFO("TLS | session ticket key rotated");
+                }
+                key = keys_[0];
+                return true;
+            }
+
+            /**
+             * @return 1 for a key that still issues tickets, 2 for an older one (the ticket is renewed) or 0 if the key
+             * expired.
+             */
+            int find(const unsigned char *name, ticket_key& key)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto now = std::chrono::steady_clock::now();
+                for (std::size_t index = 0; index < (has_previous_ ? 2 : 1); ++index)
+                {
+                    // A key issues tickets for one lifetime and accepts them for another.
+                    const auto age = now - keys_[index].created_;
+                    if (std::memcmp(keys_[index].name_, name, sizeof(ticket_key::name_)) == 0 && age < 2 * lifetime_)
+                    {
+                        key = keys_[index];
+                        return index == 0 && age < lifetime_ ? 1 : 2;
+                    }
+                }
+                return 0;
+            }
+
+        private:
+            static bool generate(ticket_key& key)
+            {
+                key.created_ = std::chrono::steady_clock::now();
+                return RAND_bytes(key.name_, sizeof(key.name_)) == 1 &&
+                       RAND_bytes(key.cipher_key_, sizeof(key.cipher_key_)) == 1 &&
+                       RAND_bytes(key.mac_key_, sizeof(key.mac_key_)) == 1;
+            }
+
+            const std::chrono::seconds lifetime_;
+            std::mutex mutex_;
+            std::array<ticket_key, 2> keys_;
+            bool has_previous_;
+        };
+
+        void free_ticket_key_ring(void * /*parent*/, void *pointer, CRYPTO_EX_DATA * /*data*/, int /*index*/,
+                                  long /*argl*/, void * /*argp*/)
+        {
+            delete static_cast<ticket_key_ring*>(pointer);
+        }
+
+        int ticket_key_ring_index()
+        {
+            static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_ticket_key_ring);
+            return index;
+        }
+
+        bool initialize_mac(mac_context *mac, unsigned char *key)
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            char digest[] = "SHA256";
+            OSSL_PARAM parameters[] = {OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key, sizeof(ticket_key::mac_key_)),
+                                       OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+                                       OSSL_PARAM_construct_end()};
+            return EVP_MAC_CTX_set_params(mac, parameters) == 1;
+#else
+            return HMAC_Init_ex(mac, key, sizeof(ticket_key::mac_key_), EVP_sha256(), nullptr) == 1;
+#endif
+        }
+
+        /**
+         * @brief Encrypts a new ticket (encrypt == 1) or finds the key of a received one. See
+         * SSL_CTX_set_tlsext_ticket_key_cb(3).
+         */
+        int on_ticket_key(SSL *ssl, unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *cipher, mac_context *mac,
+                          int encrypt)
+        {
+            auto ring = static_cast<ticket_key_ring*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_key_ring_index()));
+            ticket_key key;
+            if (!ring)
+            {
+                return encrypt ? -1 : 0;
+            }
+            if (encrypt)
+            {
+                if (!ring->get_current(key) || RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+                    EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.cipher_key_, iv) != 1 ||
+                    !initialize_mac(mac, key.mac_key_))
+                {
+                    return -1;
+                }
+                std::copy_n(key.name_, sizeof(key.name_), name);
+                return 1;
+            }
+            const auto found = ring->find(name, key);
+            if (found == 0)
+            {
+                return 0;
+            }
+            if (!initialize_mac(mac, key.mac_key_) ||
+                EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.cipher_key_, iv) != 1)
+            {
+                return -1;
+            }
+            return found;
+        }
+    }
+
+    /*static*/bool tls_resumption::enable(boost::asio::ssl::context& context, const options& options)
+    {
+        static const unsigned char session_id_context[] = "micro_tcp";
+        auto native = context.native_handle();
+        SSL_CTX_set_session_cache_mode(native, options.cache_size_ != 0 ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+        SSL_CTX_sess_set_cache_size(native, static_cast<long>(options.cache_size_));
+        SSL_CTX_set_timeout(native, static_cast<long>(options.session_lifetime_.count()));
+        if (SSL_CTX_set_session_id_context(native, session_id_context, sizeof(session_id_context) - 1) != 1)
+        {
+            MICRO_TCP_LOG_ERROR("Could not enable session resumption", "invalid session id context");
+            return false;
+        }
+        if (options.ticket_key_lifetime_ == std::chrono::seconds::zero())
+        {
+            SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+            return true;
+        }
+        std::unique_ptr<ticket_key_ring> ring(new ticket_key_ring(options.ticket_key_lifetime_));
+        const auto index = ticket_key_ring_index();
+        if (index < 0 || !ring->initialize())
+        {
+            MICRO_TCP_LOG_ERROR("Could not enable session tickets", "no ticket key");
+            return false;
+        }
+        delete static_cast<ticket_key_ring*>(SSL_CTX_get_ex_data(native, index));
+        SSL_CTX_set_ex_data(native, index, ring.release());
+        SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(native, &on_ticket_key);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(native, &on_ticket_key);
+#endif
+        return true;
+    }
+
+    bool tls_session_store::apply(SSL *ssl, const std::string& endpoint) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto session = sessions_.find(endpoint);
+        return session != sessions_.end() && SSL_set_session(ssl, session->second.get()) == 1;
+    }
+
+    void tls_session_store::save(SSL *ssl, const std::string& endpoint)
+    {
+        if (!SSL_is_init_finished(ssl))
+        {
+            return;
+        }
+        std::shared_ptr<SSL_SESSION> session(SSL_get1_session(ssl), &SSL_SESSION_free);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        // A TLS 1.3 session is not resumable before its ticket has been read.
+        if (!session || !SSL_SESSION_is_resumable(session.get()))
+#else
+        if (!session)
+#endif
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_[endpoint] = std::move(session);
+    }
+
+    void tls_session_store::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.clear();
+    }
+
+    std::size_t tls_session_store::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.size();
+    }
+}
@@ -0,0 +1,127 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_TLS_RESUMPTION_HPP
+#define MICRO_TCP_TLS_RESUMPTION_HPP
+
+#include <boost/asio/ssl/context.hpp>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace micro_tcp
+{
+    /**
+     * @brief Server side SSL/TLS session resumption. A returning client presents a session ticket (or the id of a
+     * cached session) and gets an abbreviated handshake, without certificate exchange and key agreement.
+     *
+     * Tickets are stateless: the session is encrypted with a ticket key only the server knows. A new key is generated
+     * every ticket_key_lifetime_. Tickets of the previous key are still accepted and renewed with the current key,
+     * older tickets fall back to a full handshake. The keys are never written to disk, so a restart invalidates all
+     * tickets.
+     */
+    class tls_resumption
+    {
+    public:
+        /**
+         * @brief
+         */
+        struct options
+        {
+            std::size_t cache_size_; /*!< Sessions in the server session cache, for clients without ticket support. 0 disables the cache. */
+            std::chrono::seconds session_lifetime_; /*!< How long a session may be resumed, at most ticket_key_lifetime_ so tickets outlive it. */
+            std::chrono::seconds ticket_key_lifetime_; /*!< Time a ticket key is used to issue tickets. 0 disables tickets. */
+        };
+
+        /**
+         * @brief Enable session caching and session tickets on a server context. Call it before the first handshake.
+         *
+         * @param context The server context.
+         * @param options
+         * @return False if the context could not be configured.
+         */
+        static bool enable(boost::asio::ssl::context& context, const options& options);
+    };
+
+    /**
+     * @brief Client side SSL/TLS session resumption: the last session negotiated with every remote endpoint, offered
+     * on the next connection to it. May be shared by sessions on different threads.
+     */
+    class tls_session_store
+    {
+    public:
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        tls_session_store(const tls_session_store&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        tls_session_store& operator=(const tls_session_store&) = delete;
+
+        /**
+         * @brief Default constructor.
+         */
+        tls_session_store() = default;
+
+        /**
+         * @brief Offer the stored session of an endpoint on a connection that has not started its handshake yet.
+         *
+         * @param ssl The connection.
+         * @param endpoint The remote endpoint, e.g. host:port.
+         * @return True if a session was offered.
+         */
+        bool apply(SSL *ssl, const std::string& endpoint) const;
+
+        /**
+         * @brief Store the session of a connection, if it completed its handshake and can be resumed.
+         *
+         * @param ssl The connection.
+         * @param endpoint The remote endpoint, e.g. host:port.
+         */
+        void save(SSL *ssl, const std::string& endpoint);
+
+        /**
+         * @brief Forget all sessions.
+         */
+        void clear();
+
+        /**
+         * @brief
+         *
+         * @return The amount of endpoints with a stored session.
+         */
+        std::size_t size() const;
+
+    private:
+        mutable std::mutex mutex_;
+        std::map<std::string, std::shared_ptr<SSL_SESSION>> sessions_;
+    };
+}
+
+#endif
@@ -0,0 +1,211 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#include <micro_tcp/worker_pool.hpp>
+#include <algorithm>
+
+namespace micro_tcp
+{
+    namespace
+    {
+        thread_local const worker_pool *current_pool = nullptr; /*!< Pool of the calling worker thread. */
+        thread_local std::size_t current_index = 0; /*!< Index of the calling worker thread. */
+
+        void update_max(std::atomic<std::uint64_t>& max, std::uint64_t value)
+        {
+            auto current = max.load(std::memory_order_relaxed);
+            while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            {
+                /*...*/
+            }
+        }
+    }
+
+    worker_pool::worker_pool() :
+            active_(false),
+            stopping_(false),
+            sleeping_(0),
+            next_queue_(0),
+            pending_(0),
+            max_pending_(0),
+            executed_(0),
+            stolen_(0),
+            wait_time_total_(0),
+            wait_time_max_(0)
+    {
+        /*...*/
+    }
+
+    worker_pool::~worker_pool()
+    {
+        stop();
+    }
+
+    void worker_pool::start(unsigned int num_threads)
+    {
+        if (!is_active())
+        {
+            num_threads = std::max(num_threads, 1u);
+            stopping_.store(false);
+            queues_.clear();
+            for (unsigned int worker = 0; worker < num_threads; ++worker)
+            {
+                queues_.push_back(std::make_unique<worker_queue>());
+            }
+            workers_.clear();
+            workers_.reserve(num_threads);
+            for (unsigned int worker = 0; worker < num_threads; ++worker)
+            {
+                workers_.emplace_back([this, worker]()
+                                      { run(worker); });
+            }
+            active_.store(true, std::memory_order_release);
+        }
+    }
+
+    void worker_pool::stop()
+    {
+        if (is_active())
+        {
+            stopping_.store(true);
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex_); //A worker between its predicate check and wait holds it.
+            }
+            idle_condition_.notify_all();
+            for (auto& worker : workers_)
+            {
+                worker.join();
+            }
+            workers_.clear();
+            active_.store(false, std::memory_order_release);
+        }
+    }
+
+    bool worker_pool::is_active() const
+    {
+        return active_.load(std::memory_order_acquire);
+    }
+
+    void worker_pool::submit(task_type task)
+    {
+        if (!is_active())
+        {
+            task();
+            return;
+        }
+
+        // The task is counted as pending before stopping_ is checked: a worker either sees it pending before it leaves
+        // its loop, or the task sees stopping_ and is run here.
+        update_max(max_pending_, pending_.fetch_add(1) + 1);
+        if (stopping_.load())
+        {
+            pending_.fetch_sub(1);
+            task();
+            return;
+        }
+        const auto index = current_pool == this ? current_index
+                                                : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            auto& queue = *queues_[index];
+            std::lock_guard<std::mutex> lock(queue.mutex_);
+            queue.tasks_.push_back({std::move(task), std::chrono::steady_clock::now()});
+        }
+        // Pairs with a worker counting itself in sleeping_ before it checks pending_: either that worker sees the task,
+        // or the task sees the worker and wakes it. idle_mutex_ is only taken if a worker may be asleep.
+        if (sleeping_.load() != 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex_);
+            }
+            idle_condition_.notify_one();
+        }
+    }
+
+    void worker_pool::run(std::size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        while (true)
+        {
+            queued_task task;
+            bool found = pop(index, task);
+            for (std::size_t offset = 1; !found && offset < queues_.size(); ++offset)
+            {
+                found = pop((index + offset) % queues_.size(), task);
+                if (found)
+                {
+                    stolen_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (found)
+            {
+                const auto wait_time = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - task.submitted_).count());
+                wait_time_total_.fetch_add(wait_time, std::memory_order_relaxed);
+                update_max(wait_time_max_, wait_time);
+                task.task_();
+                executed_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            sleeping_.fetch_add(1);
+            idle_condition_.wait(lock, [this]()
+            {
+                return stopping_.load() || pending_.load() != 0;
+            });
+            sleeping_.fetch_sub(1);
+            if (stopping_.load() && pending_.load() == 0)
+            {
+                break;
+            }
+        }
+        current_pool = nullptr;
+    }
+
+    bool worker_pool::pop(std::size_t index, queued_task& task)
+    {
+        auto& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        if (queue.tasks_.empty())
+        {
+            return false;
+        }
+        task = std::move(queue.tasks_.front());
+        queue.tasks_.pop_front();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    worker_pool::statistics worker_pool::get_statistics() const
+    {
+        const auto executed = executed_.load(std::memory_order_relaxed);
+        return {executed,
+                stolen_.load(std::memory_order_relaxed),
+                pending_.load(std::memory_order_relaxed),
+                max_pending_.load(std::memory_order_relaxed),
+                std::chrono::microseconds(executed != 0 ? wait_time_total_.load(std::memory_order_relaxed) / executed : 0),
+                std::chrono::microseconds(wait_time_max_.load(std::memory_order_relaxed))};
+    }
+}
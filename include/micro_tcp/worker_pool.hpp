@@ -0,0 +1,172 @@
+///
+//! @copyright Copyright (c) 2017 Stefan Broekman.
+//! @license This file is released under the MIT license.
+//! @see https://stefanbroekman.nl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///
+
+#ifndef MICRO_TCP_WORKER_POOL_HPP
+#define MICRO_TCP_WORKER_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace micro_tcp
+{
+    /**
+     * @brief A work-stealing pool of compute threads, used to run request handlers off the I/O threads.
+     *
+     * Every worker has a queue of its own. Tasks submitted from a worker go to the queue of that worker, other tasks
+     * are spread over the queues round-robin. A worker takes the oldest task of its own queue and, once that is empty,
+     * steals the oldest task of another queue, so a worker stuck in a long task does not hold up the tasks behind it.
+     * Idle workers sleep until a task is submitted.
+     */
+    class worker_pool
+    {
+    public:
+        typedef std::function<void()> task_type;
+
+        /**
+         * @brief Counters of the pool.
+         */
+        struct statistics
+        {
+            std::uint64_t executed_; /*!< Tasks run by the workers. */
+            std::uint64_t stolen_; /*!< Tasks run by another worker than the one they were queued for. */
+            std::uint64_t queue_depth_; /*!< Tasks waiting to be run. */
+            std::uint64_t max_queue_depth_; /*!< Highest amount of tasks waiting to be run. */
+            std::chrono::microseconds average_wait_time_; /*!< From submit to the start of a task. */
+            std::chrono::microseconds max_wait_time_; /*!< From submit to the start of a task. */
+        };
+
+        /**
+         * @brief Non-copyable - delete copy constructor.
+         */
+        worker_pool(const worker_pool&) = delete;
+
+        /**
+         * @brief Non-copyable - delete assignment operator.
+         */
+        worker_pool& operator=(const worker_pool&) = delete;
+
+        /**
+         * @brief Default constructor.
+         */
+        worker_pool();
+
+        /**
+         * @brief Default destructor. Stop the pool (if still active).
+         */
+        ~worker_pool();
+
+        /**
+         * @brief Start [num_threads] workers.
+         *
+         * @param num_threads The amount of workers, at least 1.
+         */
+        void start(unsigned int num_threads);
+
+        /**
+         * @brief Run the queued tasks and join the workers.
+         */
+        void stop();
+
+        /**
+         * @brief
+         *
+         * @return True if the workers are running.
+         */
+        bool is_active() const;
+
+        /**
+         * @brief Queue a task. If the pool is not active or stopping the task is run on the calling thread, so it is
+         * never left in a queue the workers no longer drain.
+         *
+         * @param task The task.
+         */
+        void submit(task_type task);
+
+        /**
+         * @brief
+         *
+         * @return A snapshot of the pool counters.
+         */
+        statistics get_statistics() const;
+
+    private:
+        /**
+         * @brief A task with the time it was submitted.
+         */
+        struct queued_task
+        {
+            task_type task_;
+            std::chrono::steady_clock::time_point submitted_;
+        };
+
+        /**
+         * @brief The queue of a single worker.
+         */
+        struct worker_queue
+        {
+            std::mutex mutex_;
+            std::deque<queued_task> tasks_;
+        };
+
+        /**
+         * @brief Run tasks until the pool is stopped and all queues are empty.
+         *
+         * @param index The index of the worker.
+         */
+        void run(std::size_t index);
+
+        /**
+         * @brief Take the oldest task of a queue.
+         *
+         * @param index The index of the queue.
+         * @param task The task, only set if the queue was not empty.
+         * @return False if the queue was empty.
+         */
+        bool pop(std::size_t index, queued_task& task);
+
+        std::atomic<bool> active_; /*!< Read by the submitting threads, written by start() and stop(). */
+        std::atomic<bool> stopping_; /*!< Tasks are only queued while it is false. */
+        std::atomic<std::size_t> sleeping_; /*!< Workers waiting on idle_condition_, or about to. */
+        std::vector<std::unique_ptr<worker_queue>> queues_;
+        std::vector<std::thread> workers_;
+        std::mutex idle_mutex_;
+        std::condition_variable idle_condition_;
+        std::atomic<std::size_t> next_queue_;
+        std::atomic<std::uint64_t> pending_;
+        std::atomic<std::uint64_t> max_pending_;
+        std::atomic<std::uint64_t> executed_;
+        std::atomic<std::uint64_t> stolen_;
+        std::atomic<std::uint64_t> wait_time_total_; /*!< Microseconds. */
+        std::atomic<std::uint64_t> wait_time_max_; /*!< Microseconds. */
+    };
+}
+
+#endif
@@ -23,9 +23,11 @@
 ///
 
 #include <micro_tcp/io_manager.hpp>
+#include <micro_tcp/logger.hpp>
 #include <micro_tcp/secure_data.hpp>
 #include <micro_tcp/server.hpp>
 #include <micro_tcp/client.hpp>
+#include <micro_tcp/tls_resumption.hpp>
 #include <boost/program_options.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
@@ -57,9 +59,28 @@ int main(int argc, const char *argv[])
     config = config.get_child("Config");
 
     /**
-     * Initialise io service.
+     * Set the log level, see the Logging section in config.xml.
      */
-    micro_tcp::io_manager io_manager;
+    micro_tcp::log_level log_level;
+    if (micro_tcp::logger::parse_level(config.get<std::string>("Logging.level", "info"), log_level))
+    {
+        micro_tcp::logger::set_level(log_level);
+    }
+
+    /**
+     * Initialise io service. Optionally with one io_service per thread, see the IO section in config.xml.
+     */
+    const auto io_service_per_thread = config.get<std::string>("IO.threading_model", "shared") == "per_thread";
+    const auto least_loaded = config.get<std::string>("IO.scheduling_policy", "round_robin") == "least_loaded";
+    micro_tcp::io_manager io_manager(io_service_per_thread ? micro_tcp::io_manager::threading_model::io_service_per_thread
+                                                           : micro_tcp::io_manager::threading_model::shared_io_service,
+                                     least_loaded ? micro_tcp::io_manager::scheduling_policy::least_loaded
+                                                  : micro_tcp::io_manager::scheduling_policy::round_robin);
+    micro_tcp::affinity_plan affinity_plan;
+    if (micro_tcp::affinity_plan::parse(config.get<std::string>("IO.affinity", "none"), affinity_plan))
+    {
+        io_manager.set_affinity_plan(affinity_plan);
+    }
     boost::asio::io_service& io_service = io_manager.get_io_service();
 
     /**
@@ -87,12 +108,53 @@ int main(int argc, const char *argv[])
     server_context.use_certificate_file(ssl_data.certificate_file_, boost::asio::ssl::context::pem);
     server_context.use_rsa_private_key_file(ssl_data.rsa_private_key_file_, boost::asio::ssl::context::pem);
     server_context.use_tmp_dh_file(ssl_data.temp_diffie_hellman_parameters_file_);
+    micro_tcp::tls_resumption::enable(server_context,
+                                      {config.get<std::size_t>("Server.session_cache_size", 20480),
+                                       std::chrono::seconds(config.get<unsigned int>("Server.session_lifetime_s", 3600)),
+                                       std::chrono::seconds(config.get<unsigned int>("Server.ticket_key_lifetime_s", 3600))});
 
     /**
      * Init request handler and instantiate a server instance.
      */
     micro_tcp::request_handler request_handler;
     micro_tcp::server server(io_service, address, port, request_handler, server_context);
+    server.set_io_manager(io_manager);
+
+    /**
+     * Optionally run the request handler on a worker pool instead of the I/O threads.
+     */
+    micro_tcp::worker_pool worker_pool;
+    const auto worker_threads = config.get<unsigned int>("Server.worker_threads", 0);
+    if (worker_threads != 0)
+    {
+        worker_pool.start(worker_threads);
+        server.set_worker_pool(worker_pool);
+    }
+    server.set_reuse_port(config.get<bool>("Server.reuse_port", false));
+    const auto transport = config.get<std::string>("Server.transport", "secure") == "plain"
+                           ? micro_tcp::transport::plain : micro_tcp::transport::secure;
+    server.set_transport(transport);
+    const auto local_path = config.get<std::string>("Server.local_path", "");
+    server.set_local_path(local_path);
+    server.set_admission_limits({config.get<std::size_t>("Server.max_sessions", 0),
+                                 config.get<std::uint32_t>("Server.max_accept_rate", 0)});
+    const std::chrono::milliseconds drain_timeout(config.get<unsigned int>("Server.drain_timeout_ms", 5000));
+
+    /**
+     * Deadlines of the server sessions, 0 disables a deadline.
+     */
+    typedef std::chrono::milliseconds::rep milliseconds;
+    const auto& default_timeouts = micro_tcp::server::default_timeouts_;
+    server.set_timeouts({std::chrono::milliseconds(config.get<milliseconds>("Server.handshake_timeout_ms",
+                                                                            default_timeouts.handshake_.count())),
+                         std::chrono::milliseconds(config.get<milliseconds>("Server.idle_timeout_ms",
+                                                                            default_timeouts.idle_.count())),
+                         std::chrono::milliseconds(config.get<milliseconds>("Server.header_read_timeout_ms",
+                                                                            default_timeouts.header_read_.count())),
+                         std::chrono::milliseconds(config.get<milliseconds>("Server.content_read_timeout_ms",
+                                                                            default_timeouts.content_read_.count()))});
+    server.set_max_content_length(config.get<std::uint64_t>("Server.max_content_length",
+                                                            micro_tcp::message::default_max_content_length_));
 
     /**
      * Initialise client SSL/TLS context.
@@ -105,6 +167,10 @@ int main(int argc, const char *argv[])
      */
     micro_tcp::response_handler response_handler;
     micro_tcp::client client(io_service, response_handler, client_context);
+    client.set_transport(transport);
+    client.set_session_resumption(config.get<bool>("Client.session_resumption", true));
+    client.set_max_content_length(config.get<std::uint64_t>("Client.max_content_length",
+                                                            micro_tcp::message::default_max_content_length_));
 
     /**
      * Start io_service work and start listening for incoming requests.
@@ -124,7 +190,7 @@ int main(int argc, const char *argv[])
         }
         else if (input == "server_stop")
         {
-            server.stop();
+            server.shutdown(drain_timeout);
         }
         else if (input == "server_set_address")
         {
@@ -140,7 +206,14 @@ int main(int argc, const char *argv[])
         }
         else if (input == "client_connect")
         {
-            client.connect(address, port);
+            if (local_path.empty())
+            {
+                client.connect(address, port);
+            }
+            else
+            {
+                client.connect_local(local_path);
+            }
         }
         else if (input == "client_disconnect")
         {
@@ -165,7 +238,16 @@ int main(int argc, const char *argv[])
                       << "\n<|Server|>"
                       << "\n Address: " << server.get_address()
                       << "\n Port: " << server.get_port()
-                      << "\n Listening: " << std::boolalpha << server.is_listening();
+                      << "\n Listening: " << std::boolalpha << server.is_listening()
+                      << "\n Sessions: " << server.get_session_count();
+            for (const auto& acceptor : server.get_acceptor_statistics())
+            {
+                std::cout << "\n  *Acceptor accepts: " << acceptor.accepts_ << " (" << acceptor.accept_rate_ << "/s)"
+                          << ", handshake start latency avg/max: " << acceptor.average_handshake_start_latency_.count()
+                          << '/' << acceptor.max_handshake_start_latency_.count() << " us"
+                          << ", pauses: " << acceptor.pauses_ << ", rejects: " << acceptor.rejects_
+                          << ", accept errors: " << acceptor.accept_errors_;
+            }
             std::cout << "\n<|Client|>"
                       << "\n Connected: " << std::boolalpha << client.is_connected();
             if(client.is_connected())
@@ -174,6 +256,46 @@ int main(int argc, const char *argv[])
                           << "\n  *Port: " << "00000";
 //                          << "\n  *Cipher: " << client.get_cipher_active_session();
             }
+            const auto pool = micro_tcp::buffer_pool::get_statistics();
+            std::cout << "\n<|Buffer pool|>"
+                      << "\n Hits (thread cache): " << pool.local_hits_
+                      << "\n Hits (global pool): " << pool.global_hits_
+                      << "\n Misses: " << pool.misses_
+                      << "\n Oversized: " << pool.oversized_;
+            if (worker_pool.is_active())
+            {
+                const auto workers = worker_pool.get_statistics();
+                std::cout << "\n<|Worker pool|>"
+                          << "\n Executed: " << workers.executed_
+                          << "\n Stolen: " << workers.stolen_
+                          << "\n Queue depth (max): " << workers.queue_depth_ << " (" << workers.max_queue_depth_ << ")"
+                          << "\n Wait time avg/max: " << workers.average_wait_time_.count() << '/'
+                          << workers.max_wait_time_.count() << " us";
+            }
+            const auto writes = micro_tcp::session::get_write_statistics();
+            std::cout << "\n<|Writes|>"
+                      << "\n Writes: " << writes.writes_
+                      << "\n Messages: " << writes.frames_
+                      << "\n Messages per write: "
+                      << (writes.writes_ != 0 ? static_cast<double>(writes.frames_) / static_cast<double>(writes.writes_) : 0.0);
+            std::cout << "\n<|TLS resumption|>";
+            for (const auto type : {boost::asio::ssl::stream_base::server, boost::asio::ssl::stream_base::client})
+            {
+                const auto handshakes = micro_tcp::session::get_handshake_statistics(type);
+                const auto total = handshakes.full_ + handshakes.resumed_;
+                std::cout << (type == boost::asio::ssl::stream_base::server ? "\n Server" : "\n Client")
+                          << " handshakes full/resumed: " << handshakes.full_ << '/' << handshakes.resumed_
+                          << " (hit rate: " << (total != 0 ? 100.0 * static_cast<double>(handshakes.resumed_) /
+                                                             static_cast<double>(total) : 0.0) << "%)";
+            }
+            const auto handlers = micro_tcp::handler_memory::get_statistics();
+            std::cout << "\n<|Handler memory|>"
+                      << "\n Arena allocations: " << handlers.arena_allocations_
+                      << "\n Heap allocations: " << handlers.heap_allocations_;
+            const auto log = micro_tcp::logger::get_statistics();
+            std::cout << "\n<|Logger|>"
+                      << "\n Written: " << log.written_
+                      << "\n Dropped: " << log.dropped_;
             std::cout << "\n##################################"
                       << "\n";
         }
@@ -191,11 +313,12 @@ int main(int argc, const char *argv[])
     }
 
     /**
-     * Disconnect any active client sessions, stop listening and stop any io_service work.
+     * Disconnect any active client sessions, stop listening, drain the server sessions and stop any io_service work.
      */
     client.disconnect();
-    server.stop();
+    server.shutdown(drain_timeout);
     io_manager.stop();
+    worker_pool.stop();
 
     return 0;
 }
\ No newline at end of file